@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <random>
+
+// Synthetic V3C sample stream for benchmarks: VPS in the first gof, then AD + OVD + GVD + AVD in every gof with random NAL unit payloads
+
+static void put_size(std::vector<uint8_t>& out, const size_t size, const int precision)
+{
+  for (int i = precision - 1; i >= 0; --i) out.push_back((size >> (8 * i)) & 0xff);
+}
+
+static std::vector<uint8_t> make_unit(const int vuh_unit_type, const int num_nalus, const int nal_size_precision, std::mt19937& rng, const bool has_nal_sample_stream_header)
+{
+  std::vector<uint8_t> unit;
+  unit.push_back(static_cast<uint8_t>(vuh_unit_type << 3));
+  unit.push_back(0);
+  unit.push_back(0);
+  unit.push_back(0);
+  if (vuh_unit_type == 0) { // VPS payload is not parsed
+    for (int i = 0; i < 20; ++i) unit.push_back(rng() & 0xff);
+    return unit;
+  }
+  if (has_nal_sample_stream_header) unit.push_back(((nal_size_precision - 1) & 0b111) << 5);
+  for (int n = 0; n < num_nalus; ++n) {
+    const size_t len = 3 + rng() % 300;
+    put_size(unit, len, nal_size_precision);
+    unit.push_back(static_cast<uint8_t>((n % 40) << 1)); // NAL unit header
+    unit.push_back(0x01);
+    for (size_t i = 2; i < len; ++i) unit.push_back(rng() & 0xff);
+  }
+  return unit;
+}
+
+static std::vector<uint8_t> make_stream(const size_t num_gofs, const int size_precision = 4, const unsigned seed = 1)
+{
+  std::mt19937 rng(seed);
+  std::vector<uint8_t> out;
+  out.push_back(((size_precision - 1) & 0b111) << 5);
+  for (size_t gof = 0; gof < num_gofs; ++gof) {
+    std::vector<std::vector<uint8_t>> units;
+    if (gof == 0) units.push_back(make_unit(0, 0, 0, rng, false));
+    units.push_back(make_unit(1, 5, 2, rng, true));
+    units.push_back(make_unit(2, 8, 4, rng, false));
+    units.push_back(make_unit(3, 8, 4, rng, false));
+    units.push_back(make_unit(4, 8, 4, rng, false));
+    for (const auto& unit : units) {
+      put_size(out, unit.size(), size_precision);
+      out.insert(out.end(), unit.begin(), unit.end());
+    }
+  }
+  return out;
+}
@@ -0,0 +1,58 @@
+#include "synthetic_stream.h"
+
+#include "V3C.h"
+#include "V3C_Gof.h"
+#include "V3C_Unit.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+// Measures building gofs and accessing their units by type, which is what the per type unit slots of V3C_Gof are for
+
+using namespace uvgV3CRTP;
+using clk = std::chrono::steady_clock;
+
+static double ms(clk::time_point begin, clk::time_point end) { return std::chrono::duration<double, std::milli>(end - begin).count(); }
+
+int main(int argc, char* argv[]) {
+  const size_t num_gofs = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 20000;
+  constexpr int NUM_REPEATS = 5;
+
+  const auto bitstream = make_stream(num_gofs);
+
+  double best_build = 1e18, best_get = 1e18, best_iterate = 1e18, best_find = 1e18;
+  size_t sink = 0; // Keep the loops from being optimized out
+  for (int rep = 0; rep < NUM_REPEATS; ++rep) {
+    const auto t0 = clk::now();
+    const auto stream = V3C::parse_bitstream(reinterpret_cast<const char*>(bitstream.data()), bitstream.size());
+    const auto t1 = clk::now();
+    for (auto it = stream.begin(); it != stream.end(); ++it) {
+      for (int type = V3C_AD; type <= V3C_AVD; ++type) sink += (*it).get(static_cast<V3C_UNIT_TYPE>(type)).type();
+    }
+    const auto t2 = clk::now();
+    for (auto it = stream.begin(); it != stream.end(); ++it) {
+      for (const auto& [type, unit] : *it) sink += type + unit.num_nalus();
+    }
+    const auto t3 = clk::now();
+    for (auto it = stream.begin(); it != stream.end(); ++it) {
+      for (int type = 0; type < NUM_V3C_UNIT_TYPES; ++type) sink += (*it).find(static_cast<V3C_UNIT_TYPE>(type)) != (*it).end();
+    }
+    const auto t4 = clk::now();
+
+    best_build = std::min(best_build, ms(t0, t1));
+    best_get = std::min(best_get, ms(t1, t2));
+    best_iterate = std::min(best_iterate, ms(t2, t3));
+    best_find = std::min(best_find, ms(t3, t4));
+  }
+
+  std::cout << num_gofs << " gofs, best of " << NUM_REPEATS << ":" << std::endl;
+  std::cout << "  parse/build       " << best_build << " ms" << std::endl;
+  std::cout << "  get() x4 per gof  " << best_get << " ms" << std::endl;
+  std::cout << "  iterate units     " << best_iterate << " ms" << std::endl;
+  std::cout << "  find() x7 per gof " << best_find << " ms" << std::endl;
+  std::cout << "  (checksum " << sink % 7 << ")" << std::endl;
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,91 @@
+#include "synthetic_stream.h"
+
+#include "V3C.h"
+#include "V3C_Gof.h"
+#include "V3C_Unit.h"
+#include "Gof_Index.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+// Measures pushing units and nalus into a long sample stream, which has to find the destination gof by free slot or by timestamp
+
+using namespace uvgV3CRTP;
+using clk = std::chrono::steady_clock;
+using V3C_Stream = Sample_Stream<SAMPLE_STREAM_TYPE::V3C>;
+
+static double ms(clk::time_point begin, clk::time_point end) { return std::chrono::duration<double, std::milli>(end - begin).count(); }
+
+int main(int argc, char* argv[]) {
+  const size_t num_gofs = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 50000;
+  constexpr size_t NUM_NALU_PUSHES = 200000;
+  constexpr size_t NUM_LATEST_GOFS = 64;
+  constexpr uint32_t GOF_TICKS = RTP_CLOCK_RATE / DEFAULT_FRAME_RATE;
+  const uint32_t first_timestamp = 0xFFFFFFFFu - GOF_TICKS * 1000u; // Timestamps wrap around 2^32 after 1000 gofs
+
+  const auto bitstream = make_stream(num_gofs);
+  const char* const data = reinterpret_cast<const char*>(bitstream.data());
+  const auto index = Gof_Index::build(data, bitstream.size());
+  auto make_unit = [&](const size_t gof, const V3C_UNIT_TYPE type) {
+    const auto& entry = index.at(gof);
+    return V3C_Unit(&data[entry.unit_offsets[type]], entry.unit_sizes[type], PARSE_FLAGS::BORROW);
+  };
+
+  // Untimed units one type at a time (all AD units, then OVD, GVD, AVD). Each unit goes to the first gof without a unit of its type
+  double untimed_push = 0;
+  {
+    V3C_Stream stream(4);
+    const auto t0 = clk::now();
+    for (const V3C_UNIT_TYPE type : {V3C_AD, V3C_OVD, V3C_GVD, V3C_AVD}) {
+      for (size_t gof = 0; gof < num_gofs; ++gof) stream.push_back(make_unit(gof, type));
+    }
+    untimed_push = ms(t0, clk::now());
+    if (stream.num_samples() != num_gofs) {
+      std::cerr << "Error: untimed units ended up in " << stream.num_samples() << " gofs" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  // Timed units in scattered order go to the gof with the matching timestamp, then nalus are pushed to the latest gofs like a receiver does
+  double timed_push = 0, nalu_push = 0;
+  {
+    V3C_Stream stream(4);
+    for (size_t gof = 0; gof < num_gofs; ++gof) stream.push_back(make_unit(gof, V3C_AD));
+    uint32_t timestamp = first_timestamp;
+    for (auto it = stream.begin(); it != stream.end(); ++it, timestamp += GOF_TICKS) stream.set_timestamp(it, timestamp);
+
+    auto t0 = clk::now();
+    for (size_t i = 0; i < num_gofs; ++i) {
+      const size_t gof = (i * 7919) % num_gofs; // Scattered so the first/last gof shortcuts do not apply
+      auto unit = make_unit(gof, V3C_OVD);
+      unit.set_timestamp(first_timestamp + GOF_TICKS * static_cast<uint32_t>(gof));
+      stream.push_back(std::move(unit));
+    }
+    timed_push = ms(t0, clk::now());
+    if (stream.num_samples() != num_gofs) {
+      std::cerr << "Error: timed units ended up in " << stream.num_samples() << " gofs" << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    t0 = clk::now();
+    size_t pushed = 0;
+    for (size_t i = 0; i < NUM_NALU_PUSHES; ++i) {
+      Nalu nalu("\x02\x01\x00", 3, V3C_GVD);
+      nalu.set_timestamp(first_timestamp + GOF_TICKS * static_cast<uint32_t>(num_gofs - 1 - (i % NUM_LATEST_GOFS)));
+      pushed += stream.push_back(std::move(nalu), V3C_OVD);
+    }
+    nalu_push = ms(t0, clk::now());
+    if (pushed != NUM_NALU_PUSHES) {
+      std::cerr << "Error: only " << pushed << " nalus found a gof" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  std::cout << num_gofs << " gofs:" << std::endl;
+  std::cout << "  untimed units, one type at a time             " << untimed_push << " ms" << std::endl;
+  std::cout << "  timed units in scattered order, wrapping 2^32 " << timed_push << " ms" << std::endl;
+  std::cout << "  " << NUM_NALU_PUSHES << " nalus to the latest " << NUM_LATEST_GOFS << " gofs            " << nalu_push << " ms" << std::endl;
+
+  return EXIT_SUCCESS;
+}
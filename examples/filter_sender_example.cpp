@@ -0,0 +1,110 @@
+#include <uvgv3crtp/version.h>
+#include <uvgv3crtp/v3c_api.h>
+
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <memory>
+
+
+// Unit types kept when extracting and sending. Here only the atlas and geometry are kept, e.g. for a geometry only client
+static const uvgV3CRTP::INIT_FLAGS unit_filter = uvgV3CRTP::INIT_FLAGS::VPS | uvgV3CRTP::INIT_FLAGS::AD | uvgV3CRTP::INIT_FLAGS::GVD;
+
+int main(int argc, char* argv[]) {
+  std::cout << "V3C RTP lib version: " << uvgV3CRTP::get_version() << std::endl;
+
+  if (argc < 2) {
+    std::cout << "Enter bitstream file name as input parameter (and optionally an output file for the filtered bitstream)" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+// ********************* Handle input reading ***********************
+//
+  std::cout << "Reading input bitstream... " << std::flush;
+  std::ifstream bitstream(argv[1], std::ios::in | std::ios::binary);
+
+  if (!bitstream.is_open()) {
+    std::cerr << "Error: Could not open input file." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  bitstream.seekg(0, bitstream.end);
+  size_t length = bitstream.tellg();
+  bitstream.seekg(0, bitstream.beg);
+
+  if (length == 0) {
+    std::cerr << "Error: Input file is empty." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  auto buf = std::make_unique<char[]>(length);
+  if (!(bitstream.read(buf.get(), length)) && !bitstream.eof()) {
+    std::cerr << "Error: Could not read input file." << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::cout << "Done" << std::endl;
+//
+// ******************************************************************
+
+// ******** Initialize sample stream with input bitstream ***********
+//
+  // The whole sample stream is parsed once. The filter is only applied when the bitstream is written or sent, so the same state can serve different unit selections
+  std::cout << "Initialize state... " << std::flush;
+  uvgV3CRTP::V3C_State<uvgV3CRTP::V3C_Sender> state(buf.get(), length,
+    uvgV3CRTP::INIT_FLAGS::VPS |
+    uvgV3CRTP::INIT_FLAGS::AD  |
+    uvgV3CRTP::INIT_FLAGS::OVD |
+    uvgV3CRTP::INIT_FLAGS::GVD |
+    uvgV3CRTP::INIT_FLAGS::AVD
+  );
+
+  if (state.get_error_flag() != uvgV3CRTP::ERROR_TYPE::OK) {
+    std::cerr << "Error initializing sample stream: " << state.get_error_msg() << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::cout << "Done" << std::endl;
+//
+// ******************************************************************
+
+// ******** Extract the selected unit types **********
+//
+  std::cout << "Full bitstream size: " << state.get_bitstream_size() << " bytes" << std::endl;
+  std::cout << "Filtered bitstream size: " << state.get_bitstream_size(unit_filter) << " bytes" << std::endl;
+
+  // Units of the other types are skipped while writing, the sample stream itself is not modified
+  size_t filtered_len = 0;
+  auto filtered = std::unique_ptr<char, decltype(&free)>(state.get_bitstream(unit_filter, &filtered_len), &free);
+  if (filtered == nullptr) {
+    std::cerr << "Error getting filtered bitstream: " << state.get_error_msg() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if (argc >= 3) { // If an output file is specified write the filtered bitstream to it
+    std::cout << "Writing filtered bitstream to file... " << std::flush;
+    std::ofstream out_file(argv[2], std::ios::out | std::ios::binary);
+    if (!out_file.is_open()) {
+      std::cerr << "Error: Could not open output file for writing." << std::endl;
+      return EXIT_FAILURE;
+    }
+    out_file.write(filtered.get(), filtered_len);
+    out_file.close();
+    std::cout << "Done" << std::endl;
+  }
+//
+// **************************************
+
+// ******** Send the selected unit types **********
+//
+  std::cout << "Sending filtered bitstream... " << std::flush;
+  uvgV3CRTP::send_bitstream(&state, unit_filter);
+
+  if (state.get_error_flag() != uvgV3CRTP::ERROR_TYPE::OK) {
+    std::cerr << "Error sending bitstream: " << state.get_error_msg() << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::cout << "Done" << std::endl;
+//
+// **************************************
+
+  return EXIT_SUCCESS;
+}
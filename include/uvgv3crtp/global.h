@@ -101,6 +101,12 @@ namespace uvgV3CRTP {
     bool var_nal_num;
   };
 
+  // Segment of an exported bitstream. Layout matches struct iovec so an array of segments can be passed to writev()
+  struct BitstreamSegment {
+    const void* base;
+    size_t len;
+  };
+
   // V3C error state flags
   enum class ERROR_TYPE {
     OK = 0,
@@ -140,6 +146,16 @@ namespace uvgV3CRTP {
   inline INIT_FLAGS operator&(INIT_FLAGS a, INIT_FLAGS b) { return static_cast<INIT_FLAGS>(static_cast<uint16_t>(a) & static_cast<uint16_t>(b)); };
   inline bool is_set(INIT_FLAGS all_flags, INIT_FLAGS flag) { return (all_flags & flag) == flag; };
 
+  // Control how an input bitstream is parsed
+  enum class PARSE_FLAGS : uint16_t {
+    NUL = 0,
+    BORROW = 1, // Nalus reference the input bitstream instead of copying it. Input needs to outlive the sample stream
+    LAZY = 2,   // V3C unit payloads are kept as a single block and split into nalus only when nalus are accessed
+  };
+  inline PARSE_FLAGS operator|(PARSE_FLAGS a, PARSE_FLAGS b) { return static_cast<PARSE_FLAGS>(static_cast<uint16_t>(a) | static_cast<uint16_t>(b)); };
+  inline PARSE_FLAGS operator&(PARSE_FLAGS a, PARSE_FLAGS b) { return static_cast<PARSE_FLAGS>(static_cast<uint16_t>(a) & static_cast<uint16_t>(b)); };
+  inline bool is_set(PARSE_FLAGS all_flags, PARSE_FLAGS flag) { return (all_flags & flag) == flag; };
+
   // Define global constants
   static constexpr int V3C_HDR_LEN = 4; // 32 bits for v3c unit header
   static constexpr int SAMPLE_STREAM_HDR_LEN = 1; // 8 bits for sample stream headers
@@ -156,6 +172,7 @@ namespace uvgV3CRTP {
   // RTP clock for video increments 90000 in RTP payload format RFC
   constexpr uint32_t RTP_CLOCK_RATE = 90000;
   constexpr uint32_t DEFAULT_FRAME_RATE = 25;
+  constexpr size_t DEFAULT_MAX_QUEUED_GOFS = 10 * DEFAULT_FRAME_RATE; // GoFs waiting to be written by a segment recording, about 10 seconds of content
   constexpr uint32_t SEND_FRAME_RATE = 4; // Limit rate for sending when using send_bitstream. (per gof and a gof may contain multiple frames)
 
   // Max number of rtp frames the v3c receiver stores before dropping frames. Mostly frames with incorrect timestamps are buffered e.g. frames getting re-ordered or dropped. Large value may slow down processing.
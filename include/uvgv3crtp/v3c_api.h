@@ -21,6 +21,10 @@ namespace uvgV3CRTP {
   class V3C_Receiver;
   template <SAMPLE_STREAM_TYPE E>
   class Sample_Stream;
+  class Sample_Stream_Parser;
+  class Sample_Stream_Writer;
+  class Segment_Recorder;
+  class Gof_Index;
 
 
   template <typename T>
@@ -74,21 +78,79 @@ namespace uvgV3CRTP {
     /**
      * @brief Initialize the sample stream from a bitstream.
      * @details Sample stream must not be initialized or should be cleared before calling this function. bitstream must contain sample stream headers to parse correctly.
+     *          With PARSE_FLAGS::BORROW NAL units reference bitstream directly instead of copying it, so bitstream must stay valid until the sample stream is cleared.
      * @param bitstream Pointer to the bitstream data.
      * @param len Length of the bitstream.
+     * @param parse_flags Flags controlling how the bitstream is parsed.
+     * @param num_threads Number of threads used for parsing V3C units. 0 uses all available hardware threads.
+     * @param unit_filter V3C unit types to keep. Other units are skipped using their size field without parsing them.
      * @return ERROR_TYPE::OK on success, error code otherwise.
      */
-    ERROR_TYPE init_sample_stream(const char* bitstream, size_t len) noexcept;
+    ERROR_TYPE init_sample_stream(const char* bitstream, size_t len, PARSE_FLAGS parse_flags = PARSE_FLAGS::NUL, size_t num_threads = 1, INIT_FLAGS unit_filter = INIT_FLAGS::ALL) noexcept;
+
+    /**
+     * @brief Initialize the sample stream from a shared bitstream without copying it.
+     * @details Sample stream must not be initialized or should be cleared before calling this function. bitstream must contain sample stream headers to parse correctly.
+     *          NAL units reference bitstream directly and the sample stream holds a reference to it until the sample stream is cleared.
+     * @param bitstream Shared pointer to the bitstream data.
+     * @param len Length of the bitstream.
+     * @param num_threads Number of threads used for parsing V3C units. 0 uses all available hardware threads.
+     * @param unit_filter V3C unit types to keep. Other units are skipped using their size field without parsing them.
+     * @return ERROR_TYPE::OK on success, error code otherwise.
+     */
+    ERROR_TYPE init_sample_stream(std::shared_ptr<const char[]> bitstream, size_t len, size_t num_threads = 1, INIT_FLAGS unit_filter = INIT_FLAGS::ALL) noexcept;
+
+    /**
+     * @brief Initialize the sample stream from a file without reading it into memory first.
+     * @details Sample stream must not be initialized or should be cleared before calling this function. File must contain sample stream headers to parse correctly.
+     *          The file is mapped read-only and NAL units reference the mapped pages directly. The mapping is released when the sample stream is cleared.
+     * @param path Path to the V3C sample stream file.
+     * @param num_threads Number of threads used for parsing V3C units. 0 uses all available hardware threads.
+     * @param unit_filter V3C unit types to keep. Other units are skipped using their size field without parsing them.
+     * @return ERROR_TYPE::OK on success, error code otherwise.
+     */
+    ERROR_TYPE init_sample_stream_from_file(const char* path, size_t num_threads = 1, INIT_FLAGS unit_filter = INIT_FLAGS::ALL) noexcept;
+
+    /**
+     * @brief Initialize the sample stream with GoFs [first_gof, last_gof) of a file.
+     * @details Sample stream must not be initialized or should be cleared before calling this function. Only the requested GoFs are parsed, other GoFs are located using a GoF index.
+     *          The index is read from index_path if it exists, otherwise it is built with a single scan of the V3C unit size fields and written to index_path (if given).
+     *          A sidecar that is corrupt, from an older format or made for a different version of the file is rebuilt and rewritten. Failing to write the sidecar is reported as an error.
+     *          The index stores the byte offset and V3C unit sizes of each GoF but no timestamps, since sample stream files do not carry any. GoF i starts i / DEFAULT_FRAME_RATE seconds into the file and a sender state assigns timestamps as usual.
+     *          The index is kept in the state, so seeking to other GoFs of the same file only needs to parse the requested GoFs. If first_gof has no VPS of its own, the VPS of the closest earlier GoF is included in the first GoF so the GoFs can be decoded and written as a valid V3C sample stream.
+     * @param path Path to the V3C sample stream file.
+     * @param first_gof Index of the first GoF to parse.
+     * @param last_gof Index one past the last GoF to parse.
+     * @param index_path Path of the GoF index sidecar file, or nullptr to not use a sidecar.
+     * @param unit_filter V3C unit types to keep. Other units are located by the index but not parsed. The index always covers all unit types.
+     * @return ERROR_TYPE::OK on success, error code otherwise.
+     */
+    ERROR_TYPE init_sample_stream_from_file(const char* path, size_t first_gof, size_t last_gof, const char* index_path = nullptr, INIT_FLAGS unit_filter = INIT_FLAGS::ALL) noexcept;
+
+    /**
+     * @brief Append an arbitrary sized chunk of a sample stream.
+     * @details Chunks are parsed incrementally: partial size fields and V3C units are buffered between calls, and each V3C unit is added to the sample stream as soon as its last byte arrives.
+     *          The first chunk needs to start with the sample stream header. The sample stream is initialized from the header if it does not exist yet.
+     *          After a parse error the position in the stream is lost, so all later chunks are rejected with ERROR_TYPE::PARSE until clear_sample_stream() is called.
+     * @param chunk Pointer to the chunk data.
+     * @param len Length of the chunk.
+     * @param unit_filter V3C unit types to keep. Other units are skipped without buffering or parsing them.
+     * @return ERROR_TYPE::OK on success, error code otherwise.
+     */
+    ERROR_TYPE append_chunk_to_sample_stream(const char* chunk, size_t len, INIT_FLAGS unit_filter = INIT_FLAGS::ALL) noexcept;
 
     /**
      * @brief Append data to the sample stream.
      * @details Sample stream must be initialized before calling this function. If has_sample_stream_headers is true, bitstream must contain sample stream headers to parse correctly. Only one V3C unit is parsed when has_sample_stream_headers is false.
+     *          With PARSE_FLAGS::BORROW bitstream must stay valid until the sample stream is cleared.
      * @param bitstream Pointer to the bitstream data.
      * @param len Length of the bitstream.
      * @param has_sample_stream_headers If true, bitstream contains sample stream headers; otherwise, a single V3C unit.
+     * @param parse_flags Flags controlling how the bitstream is parsed.
+     * @param unit_filter V3C unit types to keep. Other units are skipped using their size field without parsing them.
      * @return ERROR_TYPE::OK on success, error code otherwise.
      */
-    ERROR_TYPE append_to_sample_stream(const char* bitstream, size_t len, bool has_sample_stream_headers = false) noexcept;
+    ERROR_TYPE append_to_sample_stream(const char* bitstream, size_t len, bool has_sample_stream_headers = false, PARSE_FLAGS parse_flags = PARSE_FLAGS::NUL, INIT_FLAGS unit_filter = INIT_FLAGS::ALL) noexcept;
 
     /**
      * @brief Clear the sample stream data and reset state.
@@ -96,13 +158,43 @@ namespace uvgV3CRTP {
      */
     void clear_sample_stream() noexcept;
 
+    /**
+     * @brief Shift the timestamps of all GoFs so that the first GoF has the given timestamp.
+     * @details Only a stream level offset is updated, so the cost does not depend on the amount of data. Spacing between GoF timestamps is preserved. Useful e.g. when re-sending the same sample stream in a loop.
+     *          Sample stream must contain data with timestamps set. If not, error flag is set.
+     * @param first_timestamp New RTP timestamp of the first GoF.
+     * @return ERROR_TYPE::OK on success, error code otherwise.
+     */
+    ERROR_TYPE rebase_timestamps(uint32_t first_timestamp) noexcept;
+
     /**
      * @brief Get the full bitstream.
      * @details Sample stream must be initialized and contain data. If not, nullptr is returned and error flag is set. Returned bitstream contains sample stream headers.
      * @param length pointer to store the length of the returned bitstream.
+     * @param num_threads Number of threads writing GoFs concurrently. 0 uses all available hardware threads.
+     * @return Pointer to the bitstream (caller must free i.e. c-style free).
+     */
+    char* get_bitstream(size_t* length, size_t num_threads = 1) const noexcept;
+
+    /**
+     * @brief Get the full bitstream with the given size precisions.
+     * @details Same as get_bitstream(), but V3C unit and NAL unit size fields are rewritten with the given precisions while copying, e.g. to restore the precisions of the original bitstream after receiving with inferred precisions.
+     * @param length pointer to store the length of the returned bitstream.
+     * @param size_precision V3C unit size precision in range [1, 8], or 0 to keep the precision of the sample stream.
+     * @param nal_size_precisions NAL unit size precision in range [1, 8] for each unit type, 0 keeps the precision of the unit. Can be nullptr.
+     * @return Pointer to the bitstream (caller must free i.e. c-style free).
+     */
+    char* get_bitstream(size_t* length, uint8_t size_precision, const uint8_t nal_size_precisions[NUM_V3C_UNIT_TYPES]) const noexcept;
+
+    /**
+     * @brief Get a bitstream containing only the selected unit types.
+     * @details Sample stream must be initialized and contain data. If not, nullptr is returned and error flag is set. Returned bitstream contains sample stream headers. Units of the other types are skipped without copying or modifying the sample stream.
+     *          If the sample stream precision is inferred, the V3C unit size precision is inferred from the selected units.
+     * @param unit_filter Unit types to include.
+     * @param length pointer to store the length of the returned bitstream.
      * @return Pointer to the bitstream (caller must free i.e. c-style free).
      */
-    char* get_bitstream(size_t* length) const noexcept;
+    char* get_bitstream(INIT_FLAGS unit_filter, size_t* length) const noexcept;
 
     /**
      * @brief Get the bitstream for the current GoF.
@@ -121,6 +213,130 @@ namespace uvgV3CRTP {
      */
     char* get_bitstream_cur_gof_unit(const V3C_UNIT_TYPE type, size_t* length) const noexcept;
 
+    /**
+     * @brief Write the full bitstream into a caller provided buffer.
+     * @details Sample stream must be initialized and contain data. If not, error flag is set. Output matches get_bitstream(). If cap is smaller than get_bitstream_size(), nothing is written and error flag is set to DATA.
+     * @param dst Pointer to the destination buffer.
+     * @param cap Capacity of the destination buffer.
+     * @param written Optional pointer to store the number of bytes written.
+     * @param num_threads Number of threads writing GoFs concurrently. 0 uses all available hardware threads.
+     * @return ERROR_TYPE::OK on success, error code otherwise.
+     */
+    ERROR_TYPE write_bitstream_into(char* dst, size_t cap, size_t* written = nullptr, size_t num_threads = 1) const noexcept;
+
+    /**
+     * @brief Write a bitstream containing only the selected unit types into a caller provided buffer.
+     * @details Sample stream must be initialized and contain data. If not, error flag is set. Output matches get_bitstream(unit_filter, length). If cap is smaller than get_bitstream_size(unit_filter), nothing is written and error flag is set to DATA.
+     * @param unit_filter Unit types to include.
+     * @param dst Pointer to the destination buffer.
+     * @param cap Capacity of the destination buffer.
+     * @param written Optional pointer to store the number of bytes written.
+     * @return ERROR_TYPE::OK on success, error code otherwise.
+     */
+    ERROR_TYPE write_bitstream_into(INIT_FLAGS unit_filter, char* dst, size_t cap, size_t* written = nullptr) const noexcept;
+
+    /**
+     * @brief Write the bitstream for the current GoF into a caller provided buffer.
+     * @details Sample stream must be initialized and contain data and cur gof iterator should be valid. If not, error flag is set. Output matches get_bitstream_cur_gof(). If cap is smaller than get_bitstream_size_cur_gof(), nothing is written and error flag is set to DATA.
+     * @param dst Pointer to the destination buffer.
+     * @param cap Capacity of the destination buffer.
+     * @param written Optional pointer to store the number of bytes written.
+     * @return ERROR_TYPE::OK on success, error code otherwise.
+     */
+    ERROR_TYPE write_bitstream_into_cur_gof(char* dst, size_t cap, size_t* written = nullptr) const noexcept;
+
+    /**
+     * @brief Write the bitstream for a specific unit type in the current GoF into a caller provided buffer.
+     * @details Sample stream must be initialized and contain data and cur gof iterator should be valid. type also has to be a type present in the gof. If not, error flag is set. Output matches get_bitstream_cur_gof_unit(). If cap is smaller than get_bitstream_size_cur_gof_unit(), nothing is written and error flag is set to DATA.
+     * @param type The V3C unit type.
+     * @param dst Pointer to the destination buffer.
+     * @param cap Capacity of the destination buffer.
+     * @param written Optional pointer to store the number of bytes written.
+     * @return ERROR_TYPE::OK on success, error code otherwise.
+     */
+    ERROR_TYPE write_bitstream_into_cur_gof_unit(const V3C_UNIT_TYPE type, char* dst, size_t cap, size_t* written = nullptr) const noexcept;
+
+    /**
+     * @brief Get the length of the full bitstream returned by get_bitstream().
+     * @details Sample stream must be initialized and contain data. If not, 0 is returned and error flag is set.
+     * @return Length of the bitstream.
+     */
+    size_t get_bitstream_size() const noexcept;
+
+    /**
+     * @brief Get the length of the bitstream returned by get_bitstream(unit_filter, length).
+     * @details Sample stream must be initialized and contain data. If not, 0 is returned and error flag is set.
+     * @param unit_filter Unit types to include.
+     * @return Length of the bitstream.
+     */
+    size_t get_bitstream_size(INIT_FLAGS unit_filter) const noexcept;
+
+    /**
+     * @brief Get the length of the current GoF bitstream returned by get_bitstream_cur_gof().
+     * @details Sample stream must be initialized and contain data and cur gof iterator should be valid. If not, 0 is returned and error flag is set.
+     * @return Length of the bitstream.
+     */
+    size_t get_bitstream_size_cur_gof() const noexcept;
+
+    /**
+     * @brief Get the length of the unit bitstream returned by get_bitstream_cur_gof_unit().
+     * @details Sample stream must be initialized and contain data and cur gof iterator should be valid. type also has to be a type present in the gof. If not, 0 is returned and error flag is set.
+     * @param type The V3C unit type.
+     * @return Length of the bitstream.
+     */
+    size_t get_bitstream_size_cur_gof_unit(const V3C_UNIT_TYPE type) const noexcept;
+
+    /**
+     * @brief Get the full bitstream as segments without copying NAL unit payloads.
+     * @details Sample stream must be initialized and contain data. If not, nullptr is returned and error flag is set. Output matches get_bitstream().
+     *          Headers and size fields are stored in the returned block after the segment array, payload segments point to the data in the sample stream and are valid until the sample stream is modified or cleared.
+     *          BitstreamSegment matches the layout of struct iovec, so the segments can be passed to writev() directly (in batches of at most IOV_MAX).
+     * @param num_segments pointer to store the number of segments.
+     * @param length Optional pointer to store the total length of the bitstream.
+     * @return Pointer to the segment array (caller must free i.e. c-style free).
+     */
+    BitstreamSegment* get_bitstream_segments(size_t* num_segments, size_t* length = nullptr) const noexcept;
+
+    /**
+     * @brief Get the full bitstream as segments with the given size precisions.
+     * @details Same as get_bitstream_segments(), but size fields are written with the given precisions. Output matches get_bitstream(length, size_precision, nal_size_precisions).
+     * @param size_precision V3C unit size precision in range [1, 8], or 0 to keep the precision of the sample stream.
+     * @param nal_size_precisions NAL unit size precision in range [1, 8] for each unit type, 0 keeps the precision of the unit. Can be nullptr.
+     * @param num_segments pointer to store the number of segments.
+     * @param length Optional pointer to store the total length of the bitstream.
+     * @return Pointer to the segment array (caller must free i.e. c-style free).
+     */
+    BitstreamSegment* get_bitstream_segments(uint8_t size_precision, const uint8_t nal_size_precisions[NUM_V3C_UNIT_TYPES], size_t* num_segments, size_t* length = nullptr) const noexcept;
+
+    /**
+     * @brief Get a segmented bitstream containing only the selected unit types.
+     * @details Same as get_bitstream_segments(), but output matches get_bitstream(unit_filter, length).
+     * @param unit_filter Unit types to include.
+     * @param num_segments pointer to store the number of segments.
+     * @param length Optional pointer to store the total length of the bitstream.
+     * @return Pointer to the segment array (caller must free i.e. c-style free).
+     */
+    BitstreamSegment* get_bitstream_segments(INIT_FLAGS unit_filter, size_t* num_segments, size_t* length = nullptr) const noexcept;
+
+    /**
+     * @brief Get the bitstream for the current GoF as segments without copying NAL unit payloads.
+     * @details Same as get_bitstream_segments(), but output matches get_bitstream_cur_gof().
+     * @param num_segments pointer to store the number of segments.
+     * @param length Optional pointer to store the total length of the bitstream.
+     * @return Pointer to the segment array (caller must free i.e. c-style free).
+     */
+    BitstreamSegment* get_bitstream_segments_cur_gof(size_t* num_segments, size_t* length = nullptr) const noexcept;
+
+    /**
+     * @brief Get the bitstream for a specific unit type in the current GoF as segments without copying NAL unit payloads.
+     * @details Same as get_bitstream_segments(), but output matches get_bitstream_cur_gof_unit().
+     * @param type The V3C unit type.
+     * @param num_segments pointer to store the number of segments.
+     * @param length Optional pointer to store the total length of the bitstream.
+     * @return Pointer to the segment array (caller must free i.e. c-style free).
+     */
+    BitstreamSegment* get_bitstream_segments_cur_gof_unit(const V3C_UNIT_TYPE type, size_t* num_segments, size_t* length = nullptr) const noexcept;
+
     /**
      * @brief Reset the current GoF iterator to the first GoF.
      * @return ERROR_TYPE::OK on success, error code otherwise.
@@ -155,6 +371,69 @@ namespace uvgV3CRTP {
      */
     size_t num_gofs() const noexcept;
 
+    /**
+     * @brief Get the total number of GoFs in the file indexed by init_sample_stream_from_file(path, first_gof, last_gof, index_path).
+     * @details If no file has been indexed, 0 is returned and error flag is set to DATA.
+     * @return Total number of GoFs in the indexed file, or 0 if no file has been indexed.
+     */
+    size_t num_file_gofs() const noexcept;
+
+    /**
+     * @brief Start recording the sample stream to a file descriptor one GoF at a time.
+     * @details The V3C sample stream header is written immediately. GoFs are appended by record_gofs(), which receive_gof() also calls after each received GoF.
+     *          receive_unit() does not record GoFs, since units of the next GoF can arrive before the rest of a GoF. Call record_gofs() once all units of the earlier GoFs have been received.
+     *          With size_precision (uint8_t)-1 the precision is inferred: size fields are written with max precision and the output is compacted in place by stop_recording(), so fd needs to be readable and seekable.
+     *          The file descriptor is not closed by the state.
+     * @param fd File descriptor to write to.
+     * @param size_precision V3C unit size precision in range [1, 8], or (uint8_t)-1 to infer it.
+     * @param release_recorded_gofs If true, GoFs are removed from the sample stream after they have been written so long recordings need constant memory.
+     * @param nal_size_precisions NAL unit size precision in range [1, 8] for each unit type, 0 keeps the precision of the unit. Can be nullptr. NAL size fields are rewritten while writing.
+     * @return ERROR_TYPE::OK on success, error code otherwise.
+     */
+    ERROR_TYPE start_recording(int fd, uint8_t size_precision = static_cast<uint8_t>(-1), bool release_recorded_gofs = false, const uint8_t nal_size_precisions[NUM_V3C_UNIT_TYPES] = nullptr) noexcept;
+
+    /**
+     * @brief Start recording the sample stream to an output stream one GoF at a time.
+     * @details Same as start_recording(int fd, ...), but the size precision needs to be fixed since the output cannot be back-patched. out needs to outlive the recording.
+     * @param out Output stream to write to.
+     * @param size_precision V3C unit size precision in range [1, 8].
+     * @param release_recorded_gofs If true, GoFs are removed from the sample stream after they have been written.
+     * @param nal_size_precisions NAL unit size precision in range [1, 8] for each unit type, 0 keeps the precision of the unit. Can be nullptr.
+     * @return ERROR_TYPE::OK on success, error code otherwise.
+     */
+    ERROR_TYPE start_recording(std::ostream& out, uint8_t size_precision, bool release_recorded_gofs = false, const uint8_t nal_size_precisions[NUM_V3C_UNIT_TYPES] = nullptr) noexcept;
+
+    /**
+     * @brief Start recording the sample stream as segment files of gofs_per_segment GoFs each.
+     * @details Each segment is a complete V3C sample stream named <path_prefix>NNNNNN.v3c that starts with the latest VPS, so segments can be decoded independently.
+     *          Complete GoFs are moved out of the sample stream and written on a background thread, so receiving is not blocked by file I/O.
+     *          A manifest <path_prefix>.manifest lists the file name, number of GoFs, first timestamp, duration in seconds and size in bytes of each closed segment and is rewritten after each segment.
+     *          Durations are derived from the RTP timestamps of the GoFs, or from the default frame rate if the GoFs have no timestamps.
+     *          Only one recording can be active at a time. Write errors are reported by the next record_gofs() or stop_recording().
+     * @param path_prefix Path prefix of the segment files and the manifest.
+     * @param gofs_per_segment Number of GoFs in each segment, the last segment may be shorter.
+     * @param size_precision V3C unit size precision in range [1, 8], or (uint8_t)-1 to infer it for each segment.
+     * @param max_queued_gofs Maximum number of GoFs waiting to be written. record_gofs() blocks while the queue is full, so memory stays bounded if disk I/O falls behind. 0 does not limit the queue.
+     * @return ERROR_TYPE::OK on success, error code otherwise.
+     */
+    ERROR_TYPE start_segment_recording(const char* path_prefix, size_t gofs_per_segment, uint8_t size_precision = static_cast<uint8_t>(-1), size_t max_queued_gofs = DEFAULT_MAX_QUEUED_GOFS) noexcept;
+
+    /**
+     * @brief Write GoFs that have not been recorded yet.
+     * @details A GoF is considered complete once a later GoF exists, so the last GoF is only written if include_incomplete is set.
+     *          When receiving with receive_unit(), units of a later GoF may arrive before all units of a GoF, so only call this after the earlier GoFs have been received completely.
+     * @param include_incomplete Also write the last GoF, e.g. when the stream is known to be complete.
+     * @return ERROR_TYPE::OK on success, error code otherwise.
+     */
+    ERROR_TYPE record_gofs(bool include_incomplete = false) noexcept;
+
+    /**
+     * @brief Write all remaining GoFs and finish the recording.
+     * @details Back-patches the size precision if it was inferred. For segment recordings, waits for queued GoFs to be written and closes the last segment.
+     * @return ERROR_TYPE::OK on success, error code otherwise.
+     */
+    ERROR_TYPE stop_recording() noexcept;
+
     /**
      * @brief Advance the current GoF iterator to the next GoF.
      * @details Sets error flag to EOS if the end of the stream is reached.
@@ -193,6 +472,33 @@ namespace uvgV3CRTP {
      */
     char* get_bitstream_info_string(const INFO_FMT fmt = INFO_FMT::LOGGING, size_t* out_len = nullptr) const noexcept;
 
+    /**
+     * @brief Get a null-terminated string with information about a bitstream without parsing it into the sample stream.
+     * @details Only the sample stream size fields, NAL size fields and V3C unit headers are read, so no NAL units are copied. Output matches get_bitstream_info_string() for the same bitstream.
+     *          Does not use or modify the current sample stream. bitstream must contain sample stream headers.
+     *          Supported fmt: LOGGING, PARAM, RAW, NONE (no output). Other formats cause PARSE error.
+     * @param bitstream Pointer to the bitstream data.
+     * @param len Length of the bitstream.
+     * @param fmt Output format.
+     * @param out_len Optional pointer to store the length of the returned string.
+     * @return Pointer to the info string (caller must free i.e. c-style free).
+     */
+    char* scan_bitstream_info_string(const char* bitstream, size_t len, const INFO_FMT fmt = INFO_FMT::LOGGING, size_t* out_len = nullptr) const noexcept;
+
+    /**
+     * @brief Gather bitstream info and per GoF V3C unit headers without parsing the bitstream into the sample stream.
+     * @details Only the sample stream size fields, NAL size fields and V3C unit headers are read, so no NAL units are copied.
+     *          Does not use or modify the current sample stream. bitstream must contain sample stream headers.
+     * @param bitstream Pointer to the bitstream data.
+     * @param len Length of the bitstream.
+     * @param out_info Optional pointer to store the bitstream info.
+     * @param out_gof_headers Optional pointer that is set to an array of num_gofs * NUM_V3C_UNIT_TYPES headers indexed by [gof * NUM_V3C_UNIT_TYPES + type] (caller must free i.e. c-style free).
+     *                        vuh_unit_type is (uint8_t)V3C_UNDEF for unit types not present in a GoF.
+     * @param out_num_gofs Optional pointer to store the number of GoFs in the bitstream, which is also the number of GoFs in out_gof_headers.
+     * @return ERROR_TYPE::OK on success, error code otherwise. ERROR_TYPE::PARSE if the bitstream has no V3C units, ERROR_TYPE::GENERAL if out_gof_headers could not be allocated.
+     */
+    ERROR_TYPE scan_bitstream_info(const char* bitstream, size_t len, BitstreamInfo* out_info, HeaderStruct** out_gof_headers = nullptr, size_t* out_num_gofs = nullptr) const noexcept;
+
     /**
      * @brief Get a null-terminated string with information about the current GoF.
      * @details Sample stream must be initialized and contain data and cur gof iterator should be valid. If not, nullptr is returned and error flag is set.
@@ -384,6 +690,7 @@ namespace uvgV3CRTP {
   private:
     /// \cond DO_NOT_DOCUMENT
     friend ERROR_TYPE send_bitstream(V3C_State<V3C_Sender>* state) noexcept;
+    friend ERROR_TYPE send_bitstream(V3C_State<V3C_Sender>* state, INIT_FLAGS unit_filter) noexcept;
     friend ERROR_TYPE send_gof(V3C_State<V3C_Sender>* state) noexcept;
     friend ERROR_TYPE send_unit(V3C_State<V3C_Sender>* state, V3C_UNIT_TYPE type) noexcept;
     friend ERROR_TYPE receive_bitstream(V3C_State<V3C_Receiver>* state, const uint8_t v3c_size_precision, const uint8_t size_precisions[NUM_V3C_UNIT_TYPES], const size_t expected_num_gofs, const size_t num_nalus[NUM_V3C_UNIT_TYPES], const HeaderStruct header_defs[NUM_V3C_UNIT_TYPES], int timeout) noexcept;
@@ -399,6 +706,15 @@ namespace uvgV3CRTP {
     const INIT_FLAGS flags_;
 
     Sample_Stream<SAMPLE_STREAM_TYPE::V3C>* data_;
+    Sample_Stream_Parser* chunk_parser_;
+    Gof_Index* file_index_;
+    std::string file_index_path_; // File the index was built for
+    Sample_Stream_Writer* recorder_;
+    bool release_recorded_gofs_;
+    size_t num_recorded_gofs_; // Gofs at the start of data_ that have already been recorded
+    Segment_Recorder* segment_recorder_;
+    void write_recorded_gofs(bool include_incomplete);
+    void reposition_cur_gof(size_t num_released); // Keep the current gof iterator pointing to the same gof after gofs are removed from the start of data_
     void* cur_gof_it_;
     bool is_gof_it_valid_;
     size_t cur_gof_ind_;
@@ -425,6 +741,16 @@ namespace uvgV3CRTP {
    */
   ERROR_TYPE send_bitstream(V3C_State<V3C_Sender>* state) noexcept;
 
+  /**
+   * @brief Send only the selected unit types of the entire bitstream using the sender state.
+   * @details Same as send_bitstream(state), but units whose type is not in unit_filter are skipped, e.g. to send only the atlas and geometry of a stream.
+   *          Unit types that were not specified during state creation are not sent even if selected.
+   * @param state Pointer to the V3C_State<V3C_Sender> object.
+   * @param unit_filter Unit types to send.
+   * @return ERROR_TYPE::OK on success, error code otherwise.
+   */
+  ERROR_TYPE send_bitstream(V3C_State<V3C_Sender>* state, INIT_FLAGS unit_filter) noexcept;
+
   /**
    * @brief Send the current GoF using the sender state.
    * @details Sends the GoF pointed to by the current GoF iterator using the associated V3C_Sender connection.
@@ -495,6 +821,7 @@ namespace uvgV3CRTP {
    * @details Receives a single V3C unit from the associated V3C_Receiver connection and appends it to the sample stream.
    *          The sample stream must be initialized.
    *          CONNECTION_ERROR is set if the unit type has not been initialized.
+   *          Unlike receive_gof(), GoFs are not recorded automatically during a recording, see record_gofs().
    * @param state Pointer to the V3C_State<V3C_Receiver> object.
    * @param unit_type The V3C unit type to receive.
    * @param size_precision Size precision for the V3C unit. Auto infer if (uint8_t)-1.
@@ -0,0 +1,201 @@
+#include "Gof_Index.h"
+
+#include "V3C.h"
+#include "V3C_Unit.h"
+
+#include <algorithm>
+#include <sstream>
+
+namespace uvgV3CRTP {
+
+  static constexpr const char* GOF_INDEX_MAGIC = "uvgV3CRTP-gof-index";
+  static constexpr int GOF_INDEX_VERSION = 3;
+
+  Gof_Index Gof_Index::build(const char * const bitstream, const size_t len)
+  {
+    Gof_Index index;
+    index.size_precision_ = V3C::parse_size_precision(bitstream);
+    index.bitstream_len_ = len;
+    if (!(0 < index.size_precision_ && index.size_precision_ <= MAX_V3C_SIZE_PREC))
+    {
+      throw ParseException(
+        std::string("Error indexing bitstream in ") + __func__ +
+        " at " + __FILE__ + ":" + std::to_string(__LINE__) + " with error: sample stream precision should be in range[1, 8]"
+      );
+    }
+
+    // Units are assigned to gofs the same way as when parsing: the nth unit of a type belongs to the nth gof
+    std::array<size_t, NUM_V3C_UNIT_TYPES> num_units = {};
+    for (size_t ptr = SAMPLE_STREAM_HDR_LEN; ptr < len;) {
+      const size_t unit_start = ptr;
+      if (len - ptr < static_cast<size_t>(index.size_precision_) + V3C_HDR_LEN)
+      {
+        throw ParseException(
+          std::string("Error indexing bitstream in ") + __func__ +
+          " at " + __FILE__ + ":" + std::to_string(__LINE__) + " with error: truncated V3C unit"
+        );
+      }
+      const size_t v3c_size = V3C::parse_sample_stream_size(&bitstream[ptr], index.size_precision_);
+      ptr += index.size_precision_;
+      if (len - ptr < v3c_size)
+      {
+        throw ParseException(
+          std::string("Error indexing bitstream in ") + __func__ +
+          " at " + __FILE__ + ":" + std::to_string(__LINE__) + " with error: V3C unit size exceeds bitstream length"
+        );
+      }
+
+      const uint8_t vuh_unit_type = (bitstream[ptr] & 0b11111000) >> 3;
+      if (vuh_unit_type >= NUM_V3C_UNIT_TYPES)
+      {
+        throw ParseException(
+          std::string("Error indexing bitstream in ") + __func__ +
+          " at " + __FILE__ + ":" + std::to_string(__LINE__) + " with error: unknown V3C unit type " + std::to_string(vuh_unit_type)
+        );
+      }
+      const V3C_UNIT_TYPE type = V3C_Unit::V3C_Unit_Header::vuh_to_type(vuh_unit_type);
+      const size_t gof = num_units[type]++;
+      while (index.gofs_.size() <= gof)
+      {
+        index.gofs_.emplace_back();
+        index.gofs_.back().offset = unit_start;
+      }
+
+      Gof_Index_Entry& entry = index.gofs_[gof];
+      entry.unit_offsets[type] = ptr;
+      entry.unit_sizes[type] = v3c_size;
+      const size_t gof_end = std::max(entry.offset + entry.size, ptr + v3c_size);
+      entry.offset = std::min(entry.offset, unit_start);
+      entry.size = gof_end - entry.offset;
+
+      ptr += v3c_size;
+    }
+
+    // A VPS applies to the following gofs until the next VPS
+    size_t vps_offset = 0;
+    size_t vps_size = 0;
+    for (auto& entry : index.gofs_)
+    {
+      if (entry.unit_sizes[V3C_VPS] > 0)
+      {
+        vps_offset = entry.unit_offsets[V3C_VPS];
+        vps_size = entry.unit_sizes[V3C_VPS];
+      }
+      entry.vps_offset = vps_offset;
+      entry.vps_size = vps_size;
+    }
+
+    return index;
+  }
+
+  void Gof_Index::save(std::ostream& out_stream) const
+  {
+    // Plain text so the sidecar is portable and can be inspected by hand
+    out_stream << GOF_INDEX_MAGIC << " " << GOF_INDEX_VERSION << " " << static_cast<int>(size_precision_) << " " << bitstream_len_ << " " << gofs_.size() << "\n";
+    for (const auto& entry : gofs_)
+    {
+      out_stream << entry.offset << " " << entry.size << " " << entry.vps_offset << " " << entry.vps_size;
+      for (size_t type = 0; type < NUM_V3C_UNIT_TYPES; ++type)
+      {
+        out_stream << " " << entry.unit_offsets[type] << " " << entry.unit_sizes[type];
+      }
+      out_stream << "\n";
+    }
+  }
+
+  Gof_Index Gof_Index::load(std::istream& in_stream)
+  {
+    const auto error = [](const std::string& msg) {
+      return ParseException(std::string("Error loading gof index with error: ") + msg);
+    };
+
+    Gof_Index index;
+    std::string magic;
+    int version = 0;
+    int precision = 0;
+    size_t num_gofs = 0;
+    if (!(in_stream >> magic >> version >> precision >> index.bitstream_len_ >> num_gofs) || magic != GOF_INDEX_MAGIC)
+    {
+      throw error("not a gof index");
+    }
+    if (version != GOF_INDEX_VERSION) throw error("unsupported version " + std::to_string(version));
+    if (!(0 < precision && precision <= MAX_V3C_SIZE_PREC)) throw error("invalid size precision");
+    index.size_precision_ = static_cast<uint8_t>(precision);
+
+    // Every gof has at least one unit with a size field and a header, which bounds the number of gofs before allocating
+    const size_t len = index.bitstream_len_;
+    const size_t min_unit_len = static_cast<size_t>(precision) + V3C_HDR_LEN;
+    if (len < SAMPLE_STREAM_HDR_LEN || num_gofs > (len - SAMPLE_STREAM_HDR_LEN) / min_unit_len)
+    {
+      throw error(std::to_string(num_gofs) + " gofs do not fit in " + std::to_string(len) + " bytes");
+    }
+
+    // Entries are used as offsets into the bitstream, so they need to stay inside it
+    const auto in_bitstream = [len](const size_t offset, const size_t size) {
+      return offset >= SAMPLE_STREAM_HDR_LEN && size <= len && offset <= len - size;
+    };
+
+    index.gofs_.resize(num_gofs);
+    for (size_t gof = 0; gof < num_gofs; ++gof)
+    {
+      Gof_Index_Entry& entry = index.gofs_[gof];
+      in_stream >> entry.offset >> entry.size >> entry.vps_offset >> entry.vps_size;
+      for (size_t type = 0; type < NUM_V3C_UNIT_TYPES; ++type)
+      {
+        in_stream >> entry.unit_offsets[type] >> entry.unit_sizes[type];
+      }
+      if (!in_stream) throw error("truncated index");
+
+      if (!in_bitstream(entry.offset, entry.size)) throw error("gof " + std::to_string(gof) + " is outside the bitstream");
+      if (entry.vps_size > 0 && (entry.vps_size < V3C_HDR_LEN || !in_bitstream(entry.vps_offset, entry.vps_size)))
+      {
+        throw error("VPS of gof " + std::to_string(gof) + " is outside the bitstream");
+      }
+      for (size_t type = 0; type < NUM_V3C_UNIT_TYPES; ++type)
+      {
+        if (entry.unit_sizes[type] == 0) continue;
+        if (entry.unit_sizes[type] < V3C_HDR_LEN || !in_bitstream(entry.unit_offsets[type], entry.unit_sizes[type]))
+        {
+          throw error("V3C unit of type " + std::to_string(type) + " in gof " + std::to_string(gof) + " is outside the bitstream");
+        }
+      }
+    }
+
+    return index;
+  }
+
+  Sample_Stream<SAMPLE_STREAM_TYPE::V3C> Gof_Index::materialize(const char * const bitstream, const size_t len, const size_t first_gof, const size_t last_gof, const PARSE_FLAGS flags, const INIT_FLAGS unit_filter) const
+  {
+    if (len != bitstream_len_)
+    {
+      throw ParseException("Gof index does not match bitstream: expected length " + std::to_string(bitstream_len_) + ", got " + std::to_string(len));
+    }
+    if (first_gof > last_gof || last_gof > gofs_.size())
+    {
+      throw std::out_of_range("Invalid gof range [" + std::to_string(first_gof) + ", " + std::to_string(last_gof) + "), index has " + std::to_string(gofs_.size()) + " gofs");
+    }
+
+    Sample_Stream<SAMPLE_STREAM_TYPE::V3C> sample_stream(size_precision_);
+    if (first_gof < last_gof && is_set(unit_filter, INIT_FLAGS::VPS))
+    {
+      // Usually only the first gof has a VPS, so seeking past it needs the VPS from an earlier gof
+      const Gof_Index_Entry& entry = gofs_[first_gof];
+      if (entry.unit_sizes[V3C_VPS] == 0 && entry.vps_size > 0)
+      {
+        sample_stream.push_back(V3C_Unit(&bitstream[entry.vps_offset], entry.vps_size, flags));
+      }
+    }
+    for (size_t gof = first_gof; gof < last_gof; ++gof)
+    {
+      const Gof_Index_Entry& entry = gofs_[gof];
+      for (size_t type = 0; type < NUM_V3C_UNIT_TYPES; ++type)
+      {
+        if (entry.unit_sizes[type] == 0 || !is_set(unit_filter, static_cast<INIT_FLAGS>(1 << type))) continue;
+        sample_stream.push_back(V3C_Unit(&bitstream[entry.unit_offsets[type]], entry.unit_sizes[type], flags));
+      }
+    }
+
+    return sample_stream;
+  }
+
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "uvgv3crtp/global.h"
+#include "Sample_Stream.h"
+
+#include <array>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <cstddef>
+
+namespace uvgV3CRTP {
+
+  // Location of a single GoF inside a V3C sample stream.
+  // No timestamp is stored: sample stream files carry none, and timestamps are assigned when the gofs are sent (see V3C_State::set_timestamps).
+  // A stored value would only be gof * RTP_CLOCK_RATE / DEFAULT_FRAME_RATE, which the gof index already gives
+  struct Gof_Index_Entry {
+    size_t offset = 0; // Offset of the first V3C unit size field of the gof
+    size_t size = 0;   // Bytes from offset to the end of the last V3C unit of the gof
+    std::array<size_t, NUM_V3C_UNIT_TYPES> unit_offsets = {}; // Offset of each V3C unit (after the size field)
+    std::array<size_t, NUM_V3C_UNIT_TYPES> unit_sizes = {};   // 0 if the gof has no unit of that type
+    size_t vps_offset = 0; // Latest VPS at or before the gof (after the size field), prepended when parsing starts from a gof without its own VPS
+    size_t vps_size = 0;   // 0 if no VPS precedes the gof
+  };
+
+  // Index of GoF positions in a V3C sample stream so GoFs can be parsed without parsing the whole stream
+  class Gof_Index
+  {
+  public:
+    Gof_Index() = default;
+    ~Gof_Index() = default;
+
+    static Gof_Index build(const char * const bitstream, const size_t len); // Scan size fields only
+    static Gof_Index load(std::istream& in_stream); // Throws ParseException if the index is malformed or points outside the indexed bitstream
+    void save(std::ostream& out_stream) const;
+
+    // Parse gofs [first_gof, last_gof) of the indexed bitstream. Unit types not in unit_filter are skipped without parsing.
+    // If first_gof has no VPS, the VPS governing it is included in the first gof so the result can be decoded on its own
+    Sample_Stream<SAMPLE_STREAM_TYPE::V3C> materialize(const char * const bitstream, const size_t len, const size_t first_gof, const size_t last_gof, const PARSE_FLAGS flags = PARSE_FLAGS::NUL, const INIT_FLAGS unit_filter = INIT_FLAGS::ALL) const;
+
+    size_t num_gofs() const { return gofs_.size(); }
+    const Gof_Index_Entry& at(const size_t gof) const { return gofs_.at(gof); }
+    uint8_t size_precision() const { return size_precision_; }
+    size_t bitstream_len() const { return bitstream_len_; }
+
+  private:
+    uint8_t size_precision_ = 0;
+    size_t bitstream_len_ = 0; // Used to detect a stale index
+    std::vector<Gof_Index_Entry> gofs_;
+  };
+
+}
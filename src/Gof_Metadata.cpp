@@ -0,0 +1,194 @@
+#include "Gof_Metadata.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace uvgV3CRTP {
+
+  static constexpr uint32_t MAX_ORDERED_SPAN = 1u << 31;
+
+  template <typename T>
+  static void append_range(std::vector<T>& to, const std::vector<T>& from, const size_t first)
+  {
+    to.insert(to.end(), std::next(from.begin(), first), from.end());
+  }
+
+  template <typename T>
+  static void split_range(std::vector<T>& to, std::vector<T>& from, const size_t num)
+  {
+    to.assign(from.begin(), std::next(from.begin(), num));
+    from.erase(from.begin(), std::next(from.begin(), num));
+  }
+
+  void Gof_Metadata::push_back(const std::array<size_t, NUM_V3C_UNIT_TYPES>& unit_sizes, const uint8_t unit_mask, const bool is_timestamp_set, const uint32_t timestamp)
+  {
+    size_t gof_size = 0;
+    for (size_t type = 0; type < NUM_V3C_UNIT_TYPES; ++type)
+    {
+      unit_sizes_[type].push_back(unit_sizes[type]);
+      gof_size += unit_sizes[type];
+    }
+    gof_sizes_.push_back(gof_size);
+    unit_masks_.push_back(unit_mask);
+    timestamps_.push_back(timestamp);
+    timestamp_set_.push_back(is_timestamp_set);
+
+    for (size_t type = 0; type < NUM_V3C_UNIT_TYPES; ++type)
+    {
+      if ((unit_mask >> type) & 1) free_gofs_[type] = size();
+    }
+    extend_ordered_run(size() - 1);
+  }
+
+  void Gof_Metadata::append(Gof_Metadata&& other, const size_t first)
+  {
+    const size_t old_size = size();
+    for (size_t type = 0; type < NUM_V3C_UNIT_TYPES; ++type)
+    {
+      if (other.free_gofs_[type] > first) free_gofs_[type] = old_size + other.free_gofs_[type] - first;
+    }
+
+    append_range(gof_sizes_, other.gof_sizes_, first);
+    append_range(unit_masks_, other.unit_masks_, first);
+    for (size_t type = 0; type < NUM_V3C_UNIT_TYPES; ++type)
+    {
+      append_range(unit_sizes_[type], other.unit_sizes_[type], first);
+    }
+    append_range(timestamps_, other.timestamps_, first);
+    append_range(timestamp_set_, other.timestamp_set_, first);
+    other.clear();
+
+    for (size_t gof = old_size; gof < size(); ++gof)
+    {
+      extend_ordered_run(gof);
+    }
+  }
+
+  Gof_Metadata Gof_Metadata::split_front(const size_t num_gofs)
+  {
+    Gof_Metadata front;
+    for (size_t type = 0; type < NUM_V3C_UNIT_TYPES; ++type)
+    {
+      front.free_gofs_[type] = free_gofs_[type] <= num_gofs ? free_gofs_[type] : find_free_gof(static_cast<V3C_UNIT_TYPE>(type), num_gofs);
+      free_gofs_[type] = free_gofs_[type] > num_gofs ? free_gofs_[type] - num_gofs : 0;
+    }
+
+    split_range(front.gof_sizes_, gof_sizes_, num_gofs);
+    split_range(front.unit_masks_, unit_masks_, num_gofs);
+    for (size_t type = 0; type < NUM_V3C_UNIT_TYPES; ++type)
+    {
+      split_range(front.unit_sizes_[type], unit_sizes_[type], num_gofs);
+    }
+    split_range(front.timestamps_, timestamps_, num_gofs);
+    split_range(front.timestamp_set_, timestamp_set_, num_gofs);
+    ordered_begin_ = ordered_begin_ > num_gofs ? ordered_begin_ - num_gofs : 0;
+    front.ordered_stale_ = true; // Run of the front ends at the split, find it only if the front is searched
+    return front;
+  }
+
+  void Gof_Metadata::clear()
+  {
+    gof_sizes_.clear();
+    unit_masks_.clear();
+    for (auto& sizes : unit_sizes_)
+    {
+      sizes.clear();
+    }
+    timestamps_.clear();
+    timestamp_set_.clear();
+    free_gofs_ = {};
+    ordered_begin_ = 0;
+    ordered_stale_ = false;
+  }
+
+  size_t Gof_Metadata::num_units(const size_t gof) const
+  {
+    size_t num = 0;
+    for (uint8_t mask = unit_masks_[gof]; mask; mask &= mask - 1) ++num;
+    return num;
+  }
+
+  void Gof_Metadata::set_unit_size(const size_t gof, const V3C_UNIT_TYPE type, const size_t unit_size)
+  {
+    gof_sizes_[gof] = gof_sizes_[gof] - unit_sizes_[type][gof] + unit_size;
+    unit_sizes_[type][gof] = unit_size;
+    unit_masks_[gof] |= static_cast<uint8_t>(1u << type);
+    free_gofs_[type] = std::max(free_gofs_[type], gof + 1);
+  }
+
+  void Gof_Metadata::set_timestamp(const size_t gof, const uint32_t timestamp) const
+  {
+    // Only the pairs on either side of the gof can change order, so gofs well before the run do not affect it
+    timestamps_[gof] = timestamp;
+    timestamp_set_[gof] = true;
+    if (gof + 1 >= ordered_begin_) ordered_stale_ = true;
+  }
+
+  bool Gof_Metadata::is_ordered(const size_t gof) const
+  {
+    return timestamp_set_[gof] && timestamp_set_[gof + 1] && static_cast<int32_t>(timestamps_[gof + 1] - timestamps_[gof]) > 0;
+  }
+
+  void Gof_Metadata::extend_ordered_run(const size_t gof) const
+  {
+    if (ordered_stale_) return;
+
+    if (gof == 0 || !is_ordered(gof - 1))
+    {
+      ordered_begin_ = timestamp_set_[gof] ? gof : gof + 1;
+      return;
+    }
+    // Each step is less than MAX_ORDERED_SPAN, so the unsigned difference is the real span
+    while (ordered_begin_ < gof && timestamps_[gof] - timestamps_[ordered_begin_] >= MAX_ORDERED_SPAN) ++ordered_begin_;
+  }
+
+  void Gof_Metadata::rebuild_ordered_run() const
+  {
+    ordered_stale_ = false;
+    ordered_begin_ = size();
+    if (empty() || !timestamp_set_.back()) return;
+
+    const uint32_t last = timestamps_.back();
+    ordered_begin_ = size() - 1;
+    while (ordered_begin_ > 0 && is_ordered(ordered_begin_ - 1) && last - timestamps_[ordered_begin_ - 1] < MAX_ORDERED_SPAN) --ordered_begin_;
+  }
+
+  size_t Gof_Metadata::find_free_gof(const V3C_UNIT_TYPE type, size_t end) const
+  {
+    for (; end > 0; --end)
+    {
+      if ((unit_masks_[end - 1] >> type) & 1) return end;
+    }
+    return 0;
+  }
+
+  size_t Gof_Metadata::find_timestamp(const uint32_t timestamp) const
+  {
+    if (empty()) return 0;
+    if (ordered_stale_) rebuild_ordered_run();
+
+    if (ordered_begin_ < size())
+    {
+      // Distance from the first timestamp of the run is sorted even if the timestamps wrap around
+      const uint32_t first = timestamps_[ordered_begin_];
+      const uint32_t target = timestamp - first;
+      size_t low = ordered_begin_;
+      size_t high = size();
+      while (low < high)
+      {
+        const size_t mid = low + (high - low) / 2;
+        if (timestamps_[mid] - first < target) low = mid + 1;
+        else high = mid;
+      }
+      if (low < size() && timestamps_[low] == timestamp) return low;
+    }
+
+    // Search the rest from the end since new data usually goes to the latest gofs
+    for (size_t gof = ordered_begin_; gof > 0; --gof)
+    {
+      if (timestamp_set_[gof - 1] && timestamps_[gof - 1] == timestamp) return gof - 1; // Untimed gofs store 0, which is not a timestamp
+    }
+    return size();
+  }
+
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "uvgv3crtp/global.h"
+
+#include <array>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace uvgV3CRTP {
+
+  // Hot per-gof metadata of a Sample_Stream<V3C> kept in parallel arrays indexed by gof position.
+  // Scans over sizes, unit types and timestamps read contiguous arrays instead of pulling whole gof objects through the cache
+  class Gof_Metadata
+  {
+  public:
+    Gof_Metadata() = default;
+    ~Gof_Metadata() = default;
+
+    size_t size() const { return gof_sizes_.size(); }
+    bool empty() const { return gof_sizes_.empty(); }
+
+    void push_back(const std::array<size_t, NUM_V3C_UNIT_TYPES>& unit_sizes, const uint8_t unit_mask, const bool is_timestamp_set, const uint32_t timestamp);
+    void append(Gof_Metadata&& other, const size_t first); // Move entries [first, other.size()) to the end
+    Gof_Metadata split_front(const size_t num_gofs); // Move the first num_gofs entries to a new object
+    void clear();
+
+    uint8_t unit_mask(const size_t gof) const { return unit_masks_[gof]; } // Bit n is set if the gof has a unit of type n
+    bool has_unit(const size_t gof, const V3C_UNIT_TYPE type) const { return (unit_masks_[gof] >> type) & 1; }
+    size_t num_units(const size_t gof) const;
+    size_t unit_size(const size_t gof, const V3C_UNIT_TYPE type) const { return unit_sizes_[type][gof]; } // 0 if the gof has no unit of the type
+    size_t gof_size(const size_t gof) const { return gof_sizes_[gof]; } // Sum of v3c unit sizes
+    void set_unit_size(const size_t gof, const V3C_UNIT_TYPE type, const size_t unit_size);
+
+    size_t free_gof(const V3C_UNIT_TYPE type) const { return free_gofs_[type]; } // Index after the last gof that has a unit of the type
+
+    // Timestamps mirror the gof objects so they are mutable like Timestamp
+    bool is_timestamp_set(const size_t gof) const { return timestamp_set_[gof] != 0; }
+    uint32_t timestamp(const size_t gof) const { return timestamps_[gof]; }
+    void set_timestamp(const size_t gof, const uint32_t timestamp) const;
+    size_t find_timestamp(const uint32_t timestamp) const; // Index of the timed gof with the timestamp, size() if not found. Binary search over the ordered run of latest gofs, linear scan before it
+
+    // Whole arrays for scans
+    const std::vector<size_t>& gof_sizes() const { return gof_sizes_; }
+    const std::vector<uint8_t>& unit_masks() const { return unit_masks_; }
+    const std::vector<size_t>& unit_sizes(const V3C_UNIT_TYPE type) const { return unit_sizes_[type]; }
+    const std::vector<uint32_t>& timestamps() const { return timestamps_; }
+
+  private:
+    bool is_ordered(const size_t gof) const; // Gof and the next gof have timestamps and the next one is later, accounting for wrap-around
+    void extend_ordered_run(const size_t gof) const; // Update the ordered run after gof was added to the end
+    void rebuild_ordered_run() const;
+    size_t find_free_gof(const V3C_UNIT_TYPE type, size_t end) const; // Scan masks backwards from end
+
+    std::vector<size_t> gof_sizes_;
+    std::vector<uint8_t> unit_masks_;
+    std::array<std::vector<size_t>, NUM_V3C_UNIT_TYPES> unit_sizes_;
+    mutable std::vector<uint32_t> timestamps_;
+    mutable std::vector<uint8_t> timestamp_set_;
+
+    std::array<size_t, NUM_V3C_UNIT_TYPES> free_gofs_ = {};
+    // Latest gofs [ordered_begin_, size()) have increasing timestamps spanning less than 2^31 ticks, so offsets from the first one are sorted even across wrap-around.
+    // Rebuilt lazily when a timestamp inside the run changes
+    mutable size_t ordered_begin_ = 0;
+    mutable bool ordered_stale_ = false;
+  };
+
+}
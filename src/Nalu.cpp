@@ -17,18 +17,27 @@ namespace uvgV3CRTP {
 
     //Create bitstream
     write_header(type);
-    memcpy(bitstream_.get() + nal_unit_header_size, payload, payload_len);
+    memcpy(owned_bitstream_.get() + nal_unit_header_size, payload, payload_len);
   }
 
-  Nalu::Nalu(const char * const bitstream, const size_t len, const V3C_UNIT_TYPE type):
+  Nalu::Nalu(const char * const bitstream, const size_t len, const V3C_UNIT_TYPE type, const bool copy_bitstream):
     Timestamp()
   {
     if (type == V3C_VPS) throw std::invalid_argument("This constructor should not be used to initialize VPS payload NALU");
 
-    init_bitstream(len);
+    if (copy_bitstream)
+    {
+      init_bitstream(len);
 
-    //Copy input bitstream
-    memcpy(bitstream_.get(), bitstream, len);
+      //Copy input bitstream
+      memcpy(owned_bitstream_.get(), bitstream, len);
+    }
+    else
+    {
+      // Only reference the input bitstream, caller is responsible for keeping it alive
+      size_ = len;
+      bitstream_ = reinterpret_cast<const uint8_t*>(bitstream);
+    }
 
     parse_header(type);
   }
@@ -38,9 +47,15 @@ namespace uvgV3CRTP {
   //  delete[] bitstream_;
   //}
 
-  uint8_t * Nalu::bitstream() const
+  const uint8_t * Nalu::bitstream() const
+  {
+    return bitstream_;
+  }
+
+  uint8_t * Nalu::mutable_bitstream()
   {
-    return bitstream_.get();
+    if (is_borrowed()) throw std::logic_error("Borrowed nalu bitstream is read-only");
+    return owned_bitstream_.get();
   }
 
   size_t Nalu::size() const
@@ -48,6 +63,11 @@ namespace uvgV3CRTP {
     return size_;
   }
 
+  bool Nalu::is_borrowed() const
+  {
+    return bitstream_ != nullptr && !owned_bitstream_;
+  }
+
   uint8_t Nalu::nal_unit_type() const
   {
     return nal_unit_type_;
@@ -67,8 +87,8 @@ namespace uvgV3CRTP {
   {
     //Allocate memory for new bitstream
     size_ = len;
-    bitstream_ = std::make_unique<uint8_t[]>(size_);
-    memset(bitstream_.get(), 0, size_);
+    owned_bitstream_ = std::unique_ptr<uint8_t[]>(new uint8_t[size_]); // Left uninitialized, callers overwrite the whole bitstream
+    bitstream_ = owned_bitstream_.get();
   }
 
   //Error if undef or VPS (does not have NAL)
@@ -177,8 +197,8 @@ namespace uvgV3CRTP {
     char h_byte1 = ((0b00111111 & nal_unit_type_) << 1) | ((0b00100000 & nal_layer_id_) >> 5);
     char h_byte2 = ((0b00011111 & nal_layer_id_) << 3) | (0b00000111 & nal_temporal_id_);
 
-    bitstream_[0] = h_byte1;
-    bitstream_[1] = h_byte2;
+    owned_bitstream_[0] = h_byte1;
+    owned_bitstream_[1] = h_byte2;
   }
 
 }
\ No newline at end of file
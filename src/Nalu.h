@@ -12,7 +12,7 @@ namespace uvgV3CRTP {
   {
   public:
     Nalu() = default; // Not necessarily a valid nalu
-    Nalu(const char * const bitstream, const size_t len, const V3C_UNIT_TYPE type);
+    Nalu(const char * const bitstream, const size_t len, const V3C_UNIT_TYPE type, const bool copy_bitstream = true); // If copy_bitstream is false, the nalu only references bitstream which needs to outlive the nalu
     Nalu(const uint8_t nal_unit_type, const uint8_t nal_layer_id, const uint8_t nal_temporal_id, const char * const payload, const size_t payload_len, const V3C_UNIT_TYPE type);
     ~Nalu() = default;
 
@@ -22,8 +22,10 @@ namespace uvgV3CRTP {
     Nalu(Nalu&&) = default;
     Nalu& operator=(Nalu&&) = default;
 
-    uint8_t* bitstream() const;
+    const uint8_t* bitstream() const;
+    uint8_t* mutable_bitstream(); // Only for owned bitstreams, a borrowed buffer may be read-only memory
     size_t size() const;
+    bool is_borrowed() const; // True if the nalu references a buffer it does not own (e.g. input bitstream or a V3C unit payload block)
 
     uint8_t nal_unit_type() const;
     uint8_t nal_layer_id() const;
@@ -46,7 +48,8 @@ namespace uvgV3CRTP {
     uint8_t nal_temporal_id_ = 0;
 
     size_t size_ = 0;
-    std::unique_ptr<uint8_t[]> bitstream_;
+    const uint8_t* bitstream_ = nullptr; // Points either to owned_bitstream_ or to a borrowed external buffer
+    std::unique_ptr<uint8_t[]> owned_bitstream_;
   };
 
 }
\ No newline at end of file
@@ -4,8 +4,12 @@
 #include "V3C_Gof.h"
 #include "V3C_Unit.h"
 
-#include <numeric>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
 #include <exception>
+#include <system_error>
 
 namespace uvgV3CRTP {
 
@@ -23,10 +27,16 @@ namespace uvgV3CRTP {
   {
   }
 
+  // Streams store either (size, sample) pairs or plain samples
+  template <typename Size, typename SampleType>
+  static const SampleType& sample_of(const std::pair<Size, SampleType>& entry) { return entry.second; }
+  template <typename SampleType>
+  static const SampleType& sample_of(const SampleType& entry) { return entry; }
+
   template <typename SampleType, template <typename> class StreamType>
   const SampleType & SampleStreamIterator<SampleType, StreamType>::operator*() const
   {
-    return it->second;
+    return sample_of(*it);
   }
 
   template <typename SampleType, template <typename> class StreamType>
@@ -68,6 +78,27 @@ namespace uvgV3CRTP {
   //{
   //}
 
+  static void check_unit_size(const size_t unit_size, const uint8_t precision)
+  {
+    if (precision < MAX_V3C_SIZE_PREC && (unit_size >> (precision * SIZE_PREC_MULT)) != 0)
+    {
+      throw std::length_error("V3C unit of " + std::to_string(unit_size) + " bytes does not fit size precision " + std::to_string(precision));
+    }
+  }
+
+  // Nal size precision requested for a unit type, 0 keeps the unit precision
+  static uint8_t target_nal_precision(const uint8_t nal_size_precisions[NUM_V3C_UNIT_TYPES], const V3C_UNIT_TYPE type)
+  {
+    return (nal_size_precisions && type != V3C_VPS) ? nal_size_precisions[type] : 0;
+  }
+
+  Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::Sample_Stream(const uint8_t size_precision) : size_precision_(size_precision)
+  {
+    if (size_precision_ > MAX_V3C_SIZE_PREC && size_precision_ != static_cast<uint8_t>(-1)) {
+      throw std::invalid_argument("Size precision needs to be [1,8] or (uint8_t)-1.");
+    }
+  }
+
   bool Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::push_back(Nalu&& nalu, const V3C_UNIT_TYPE type)
   {
     if (stream_.empty() || !nalu.is_timestamp_set())
@@ -83,8 +114,11 @@ namespace uvgV3CRTP {
       // No matching timestamp found
       return false;
     }
+    nalu.unset_timestamp(); // Matched by timestamp, so the nalu inherits the gof timestamp
 
-    stream_.at(push_gof_ind).second.get(type).push_back(std::move(nalu));
+    auto& unit = stream_.at(push_gof_ind).get(type);
+    unit.push_back(std::move(nalu));
+    set_unit_size(push_gof_ind, type, unit.size()); // Unit grew so its size field needs to be updated
 
     return true;
   }
@@ -100,18 +134,30 @@ namespace uvgV3CRTP {
     }
     else
     {
+      make_relative(unit);
       auto& push_gof = stream_.at(push_gof_ind);
-      push_gof.first[unit.type()] = unit.size();
-      push_gof.second.set(std::move(unit));
+      const auto type = unit.type();
+      const auto unit_size = unit.size();
+      push_gof.set(std::move(unit));
+      set_unit_size(push_gof_ind, type, unit_size);
+      // An untimed gof adopts the timestamp of its first timed unit
+      if (push_gof.is_timestamp_set() && !meta_.is_timestamp_set(push_gof_ind)) meta_.set_timestamp(push_gof_ind, push_gof.get_timestamp());
     }
   }
 
   void Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::push_back(V3C_Gof && gof)
   {
-    std::map<V3C_UNIT_TYPE, size_t> size_map = std::map<V3C_UNIT_TYPE, size_t>{};
+    make_relative(gof);
+
+    std::array<size_t, NUM_V3C_UNIT_TYPES> unit_sizes = {};
+    uint8_t unit_mask = 0;
+    size_t gof_size = 0;
     for (const auto&[type, unit] : gof)
     {
-      size_map[type] = unit.size();
+      unit_sizes[type] = unit.size();
+      unit_mask |= static_cast<uint8_t>(1u << type);
+      gof_size += unit_sizes[type];
+      ++num_units_;
     }
     
     // Check timestamps to decide how to proceed
@@ -145,7 +191,14 @@ namespace uvgV3CRTP {
       gof.set_timestamp(timestamp);
     }
     // Push gof directly to stream
-    stream_.emplace_back(std::move(size_map), std::move(gof));
+    total_unit_size_ += gof_size;
+    if (gof_size >= max_gof_size_)
+    {
+      max_gof_size_ = gof_size;
+      max_gof_size_stale_ = false;
+    }
+    meta_.push_back(unit_sizes, unit_mask, gof.is_timestamp_set(), gof.get_timestamp());
+    stream_.push_back(std::move(gof));
   
     if (!is_timestamp_contiguous)
     {
@@ -153,37 +206,102 @@ namespace uvgV3CRTP {
     }
   }
 
+  // A gof split over the end of one stream and the start of the next has disjoint units and matching timestamps, if they are set
+  static bool is_boundary_gof(const V3C_Gof& back, const V3C_Gof& front)
+  {
+    if (back.is_timestamp_set() && front.is_timestamp_set() && back.get_timestamp() != front.get_timestamp()) return false;
+    for (const auto&[type, unit] : front)
+    {
+      if (back.find(type) != back.cend()) return false;
+    }
+    return true;
+  }
+
   void Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::push_back(Sample_Stream<SAMPLE_STREAM_TYPE::V3C>&& other)
   {
     if (this == &other || other.stream_.empty()) return; // No-op if trying to push self or other stream is empty
 
-    // Check if timestamps are contiguous
-    const bool need_init_timestamp = !this->stream_.empty() && this->back().is_timestamp_set() &&
-                                                              !other.front().is_timestamp_set();
-    const bool are_timestamps_contiguous = this->stream_.empty() ||
-                                         !(this->back().is_timestamp_set() && other.front().is_timestamp_set()) ||
-                                          (V3C::calc_new_timestamp(this->back().get_timestamp(), DEFAULT_FRAME_RATE, RTP_CLOCK_RATE) == other.front().get_timestamp());
-    auto timestamp = this->back().get_timestamp();
+    // Bring other to the same timestamp base. An empty stream takes over the offset so no timestamps need to be touched
+    if (stream_.empty())
+    {
+      timestamp_offset_ = other.timestamp_offset_;
+    }
+    else if (other.timestamp_offset_ != timestamp_offset_)
+    {
+      const uint32_t shift = other.timestamp_offset_ - timestamp_offset_;
+      for (size_t i = 0; i < other.meta_.size(); ++i)
+      {
+        if (other.meta_.is_timestamp_set(i)) other.set_relative_timestamp(i, other.meta_.timestamp(i) + shift);
+      }
+      other.timestamp_offset_ = timestamp_offset_;
+    }
 
-    // Insert existing stream from other to the end of this stream
-    for (auto& [size_map, gof] : other.stream_)
+    size_t first = 0;
+    bool are_timestamps_contiguous = true;
+    if (!stream_.empty())
     {
-      // If timestamps need to be initialized, do it here
-      if (need_init_timestamp)
+      const size_t back = stream_.size() - 1;
+      V3C_Gof& back_gof = stream_.back();
+
+      // Only a partial gof at the boundary needs to be merged unit by unit, the rest are moved as is
+      if (is_boundary_gof(back_gof, other.stream_.front()))
       {
-        timestamp = V3C::calc_new_timestamp(timestamp, DEFAULT_FRAME_RATE, RTP_CLOCK_RATE);
-        gof.set_timestamp(timestamp);
+        for (auto& [type, unit] : other.stream_.front())
+        {
+          const size_t unit_size = unit.size();
+          back_gof.set(std::move(unit));
+          set_unit_size(back, type, unit_size);
+        }
+        other.total_unit_size_ -= other.meta_.gof_size(0);
+        other.num_units_ -= other.meta_.num_units(0);
+        other.max_gof_size_stale_ = true; // Merged gof may have been the largest
+        ++first;
       }
-      // Push v3c units back individually in case of partial gofs
-      for (auto& [type, unit] : gof)
+
+      if (first < other.stream_.size())
       {
-        // Push each unit to this stream
-        this->push_back(std::move(unit));
+        if (meta_.is_timestamp_set(back) && !other.meta_.is_timestamp_set(first))
+        {
+          // Initialize timestamps of the appended gofs
+          auto timestamp = meta_.timestamp(back);
+          for (size_t i = first; i < other.stream_.size(); ++i)
+          {
+            timestamp = V3C::calc_new_timestamp(timestamp, DEFAULT_FRAME_RATE, RTP_CLOCK_RATE);
+            other.set_relative_timestamp(i, timestamp);
+          }
+        }
+        else if (meta_.is_timestamp_set(back) && other.meta_.is_timestamp_set(first))
+        {
+          are_timestamps_contiguous = V3C::calc_new_timestamp(meta_.timestamp(back), DEFAULT_FRAME_RATE, RTP_CLOCK_RATE) == other.meta_.timestamp(first);
+        }
       }
     }
 
+    // Move the remaining gofs with their metadata and take over their running totals
+    if (first < other.stream_.size())
+    {
+      max_gof_size_ = std::max(max_gof_size_, other.max_gof_size_);
+      max_gof_size_stale_ = max_gof_size_stale_ || other.max_gof_size_stale_;
+      total_unit_size_ += other.total_unit_size_;
+      num_units_ += other.num_units_;
+      stream_.insert(stream_.end(), std::make_move_iterator(std::next(other.stream_.begin(), first)), std::make_move_iterator(other.stream_.end()));
+      meta_.append(std::move(other.meta_), first);
+    }
+
     // Clear other stream
     other.stream_.clear();
+    other.meta_.clear();
+    other.total_unit_size_ = 0;
+    other.num_units_ = 0;
+    other.max_gof_size_ = 0;
+    other.max_gof_size_stale_ = false;
+
+    // Take over buffers that the moved nalus may still reference
+    for (auto& buffer : other.backing_buffers_)
+    {
+      add_backing_buffer(std::move(buffer));
+    }
+    other.backing_buffers_.clear();
 
     // Raise exception if timestamps are not contigious
     if (!are_timestamps_contiguous)
@@ -192,6 +310,76 @@ namespace uvgV3CRTP {
     }
   }
 
+  size_t Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::release_front(const size_t num_gofs)
+  {
+    return split_front(num_gofs).num_samples();
+  }
+
+  Sample_Stream<SAMPLE_STREAM_TYPE::V3C> Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::split_front(const size_t num_gofs)
+  {
+    Sample_Stream<SAMPLE_STREAM_TYPE::V3C> front_stream(size_precision_);
+    front_stream.timestamp_offset_ = timestamp_offset_;
+    const size_t num_split = std::min(num_gofs, stream_.size());
+    if (num_split == 0) return front_stream;
+
+    for (size_t i = 0; i < num_split; ++i)
+    {
+      const size_t gof_size = meta_.gof_size(i);
+      const size_t num_units = meta_.num_units(i);
+      total_unit_size_ -= gof_size;
+      num_units_ -= num_units;
+      front_stream.total_unit_size_ += gof_size;
+      front_stream.num_units_ += num_units;
+      front_stream.max_gof_size_ = std::max(front_stream.max_gof_size_, gof_size);
+    }
+    const auto split_end = std::next(stream_.begin(), num_split);
+    front_stream.stream_.insert(front_stream.stream_.end(), std::make_move_iterator(stream_.begin()), std::make_move_iterator(split_end));
+    stream_.erase(stream_.begin(), split_end);
+    front_stream.meta_ = meta_.split_front(num_split);
+    max_gof_size_stale_ = true; // Largest gof may have been moved
+
+    // Moved nalus may reference any of the backing buffers. Units that own their buffer take it with them
+    if (stream_.empty())
+    {
+      front_stream.backing_buffers_ = std::move(backing_buffers_);
+      backing_buffers_.clear();
+    }
+    else
+    {
+      front_stream.backing_buffers_ = backing_buffers_;
+    }
+
+    return front_stream;
+  }
+
+  void Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::set_unit_size(const size_t gof, const V3C_UNIT_TYPE type, const size_t unit_size)
+  {
+    const size_t old_gof_size = meta_.gof_size(gof);
+    if (!meta_.has_unit(gof, type)) ++num_units_;
+    total_unit_size_ = total_unit_size_ - meta_.unit_size(gof, type) + unit_size;
+    meta_.set_unit_size(gof, type, unit_size);
+
+    const size_t new_gof_size = meta_.gof_size(gof);
+    if (new_gof_size >= max_gof_size_)
+    {
+      max_gof_size_ = new_gof_size;
+      max_gof_size_stale_ = false;
+    }
+    else if (old_gof_size == max_gof_size_ && new_gof_size < old_gof_size)
+    {
+      // Largest gof got smaller, some other gof may now be the largest
+      max_gof_size_stale_ = true;
+    }
+  }
+
+  void Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::add_backing_buffer(std::shared_ptr<const char[]> buffer)
+  {
+    if (!buffer) return;
+    // Same buffer is typically added by consecutive parse calls, only store it once
+    if (!backing_buffers_.empty() && backing_buffers_.back() == buffer) return;
+    backing_buffers_.push_back(std::move(buffer));
+  }
+
   /* Calculate GOF size
     *
     + 1 byte of Sample Stream Precision
@@ -225,41 +413,42 @@ namespace uvgV3CRTP {
 
   size_t Sample_Stream<SAMPLE_STREAM_TYPE::NAL>::size() const
   {
-    size_t stream_size = header_size; // Include sample stream header size
-    for (Iterator it = stream_.begin(); it != stream_.end(); ++it)
+    // Include sample stream header size and sample stream unit size fields
+    return header_size + stream_.size() * size_precision() + total_nalu_size_;
+  }
+
+  size_t Sample_Stream<SAMPLE_STREAM_TYPE::NAL>::size(const uint8_t size_precision) const
+  {
+    return header_size + stream_.size() * size_precision + total_nalu_size_;
+  }
+
+  void Sample_Stream<SAMPLE_STREAM_TYPE::NAL>::check_size_precision(const uint8_t size_precision) const
+  {
+    if (size_precision == 0 || size_precision > MAX_V3C_SIZE_PREC) throw std::invalid_argument("Size precision needs to be [1,8].");
+    if (size_precision < MAX_V3C_SIZE_PREC && (max_nalu_size_ >> (size_precision * SIZE_PREC_MULT)) != 0)
     {
-      // Account for sample stream unit size size
-      stream_size += size_precision();
-      stream_size += it.it->first;
+      throw std::length_error("Nalu of " + std::to_string(max_nalu_size_) + " bytes does not fit size precision " + std::to_string(size_precision));
     }
-    return stream_size;
   }
 
   size_t Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::size() const
   {
-    size_t stream_size = SAMPLE_STREAM_HDR_LEN; // Include sample stream header size
-    for (Iterator it = stream_.begin(); it != stream_.end(); ++it)
-    {
-      stream_size += size(it);
-    }
-    return stream_size;
+    // Include sample stream header size and sample stream unit size fields
+    return SAMPLE_STREAM_HDR_LEN + num_units_ * size_precision() + total_unit_size_;
   }
 
   size_t Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::size(Iterator gof_it) const
   {
-    size_t stream_size = 0;
-    for (const auto&[type, sub_size] : gof_it.it->first)
-    {
-      // Get size of v3c unit
-      stream_size += size(gof_it, type);
-    }
-    return stream_size;
+    const size_t gof = index(gof_it);
+    return meta_.num_units(gof) * size_precision() + meta_.gof_size(gof);
   }
 
   size_t Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::size(Iterator gof_it, const V3C_UNIT_TYPE unit_type) const
   {
     // Account for sample stream unit size size
-    return size_precision() + gof_it.it->first.at(unit_type);
+    const size_t gof = index(gof_it);
+    if (!meta_.has_unit(gof, unit_type)) throw std::out_of_range("Gof has no V3C unit of type " + std::to_string(unit_type));
+    return size_precision() + meta_.unit_size(gof, unit_type);
   }
 
   size_t Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::num_samples() const
@@ -272,73 +461,26 @@ namespace uvgV3CRTP {
     return stream_.size();
   }
 
-  static uint8_t calc_min_size_precision(const size_t size)
-  {
-    if (size < (1LLU << (1 * SIZE_PREC_MULT))) return 1; // 1 is the smallest allowed precision and number of size bits is prec * SIZE_PREC_MULT
-    
-    // Precision should be in range [1, 8] so start checking from 4
-    if (size < (1LLU << (4 * SIZE_PREC_MULT)))
-    {
-      if (size < (1LLU << (3 * SIZE_PREC_MULT)))
-      {
-        if (size < (1LLU << (2 * SIZE_PREC_MULT)))
-        {
-          return 2;
-        } 
-        else //(1 << 2 * SIZE_PREC_MULT)) <= size < (1 << 3 * SIZE_PREC_MULT)) 
-        {
-          return 3;
-        }
-      }
-      else //(1 << 3 * SIZE_PREC_MULT)) <= size < (1 << 4 * SIZE_PREC_MULT)) 
-      {
-        return 4;
-      }
-    } else // (size >= (1 << 4 * SIZE_PREC_MULT))
-    {
-      if (size < (1LLU << (6 * SIZE_PREC_MULT)))
-      {
-        if (size < (1LLU << (5 * SIZE_PREC_MULT)))
-        {
-          return 5;
-        } 
-        else //(1 << 5 * SIZE_PREC_MULT)) <= size < (1 << 6 * SIZE_PREC_MULT)) 
-        {
-          return 6;
-        }
-      } 
-      else if /*(1 << 6 * SIZE_PREC_MULT) <=*/ (size < (1LLU << (7 * SIZE_PREC_MULT)))
-      {
-        return 7;
-      }
-    }
-
-    // Would overflow size_t anyway
-    //if (size >= (1LLU << (8 * SIZE_PREC_MULT))) throw std::runtime_error("Size exceeds maximum size precision range");
-
-    return 8;
-  }
-
   uint8_t Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::size_precision() const
   {
     // If size_precision_ is -1, infer it from max size sample size
     if (size_precision_ != static_cast<uint8_t>(-1)) return size_precision_;
 
-    size_t max_sample_size = 0;
-    for (const auto& [sizes, sample]: stream_)
+    if (max_gof_size_stale_)
     {
-      size_t cur_size = std::accumulate(sizes.cbegin(), sizes.cend(), 0LLU,
-        [](const size_t a, decltype(*sizes.cbegin()) b)
-        {
-          return a + b.second;
-        });
-      if (max_sample_size < cur_size)
-      {
-        max_sample_size = cur_size;
-      }
+      const auto& gof_sizes = meta_.gof_sizes();
+      max_gof_size_ = gof_sizes.empty() ? 0 : *std::max_element(gof_sizes.begin(), gof_sizes.end());
+      max_gof_size_stale_ = false;
     }
 
-    return calc_min_size_precision(max_sample_size);
+    return V3C::min_size_precision(max_gof_size_);
+  }
+
+  uint8_t Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::target_size_precision(const uint8_t size_precision) const
+  {
+    if (size_precision == 0) return this->size_precision();
+    if (size_precision > MAX_V3C_SIZE_PREC) throw std::invalid_argument("Size precision needs to be [1,8] or 0.");
+    return size_precision;
   }
 
   uint8_t Sample_Stream<SAMPLE_STREAM_TYPE::NAL>::size_precision() const
@@ -346,16 +488,7 @@ namespace uvgV3CRTP {
     // If size_precision_ is -1, infer it from max size sample size
     if (size_precision_ != static_cast<uint8_t>(-1)) return size_precision_;
 
-    size_t max_sample_size = 0;
-    for (const auto&[size, sample] : stream_)
-    {
-      if (max_sample_size < size)
-      {
-        max_sample_size = size;
-      }
-    }
-
-    return calc_min_size_precision(max_sample_size);
+    return V3C::min_size_precision(max_nalu_size_);
   }
 
   typename Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::Iterator Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::begin() const
@@ -370,12 +503,12 @@ namespace uvgV3CRTP {
 
   const Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::SampleType& Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::front() const
   {
-    return stream_.front().second;
+    return stream_.front();
   }
 
   const Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::SampleType& Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::back() const
   {
-    return stream_.back().second;
+    return stream_.back();
   }
 
   typename Sample_Stream<SAMPLE_STREAM_TYPE::NAL>::Iterator Sample_Stream<SAMPLE_STREAM_TYPE::NAL>::begin() const
@@ -400,55 +533,54 @@ namespace uvgV3CRTP {
 
   size_t Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::find_free_gof(const V3C_UNIT_TYPE type) const
   {
-    if (stream_.empty()) return 0; // No gofs yet so return first index
+    // Index after the last gof that has the respective v3c unit, kept up to date as units are added
+    return meta_.free_gof(type);
+  }
 
-    // Iterate backwards until a gof is found that has the respective v3c unit and return the next index
-    size_t ind = stream_.size();
-    for (auto it = std::prev(this->end()); it != this->begin(); --it)
-    {
-      if ((*it).find(type) != (*it).cend()) // Check if type exists in cur gof
-      {
-        //Found a full gof, return next index (i.e. current ind)
-        return ind;
-      }
-      ind--;
-    }
+  void Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::rebase_timestamps(const uint32_t first_timestamp)
+  {
+    if (stream_.empty()) return;
+    if (!meta_.is_timestamp_set(0)) throw TimestampException("Cannot rebase timestamps of a stream without timestamps");
 
-    // Need to check if first gof is free. If it is return 0, else the second gof index i.e. ind = 1
-    return (this->front().find(type) != this->front().cend()) ? ind : 0;
+    timestamp_offset_ = first_timestamp - meta_.timestamp(0);
   }
 
-  size_t Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::find_timestamp(const uint32_t timestamp) const
+  void Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::set_timestamp(Iterator gof_it, const uint32_t timestamp) const
   {
-    if (stream_.empty()) return 0; // No gofs yet so return first index
+    set_relative_timestamp(index(gof_it), timestamp - timestamp_offset_);
+  }
 
-    const uint32_t first_timestamp = this->front().get_timestamp();
-    const uint32_t last_timestamp = this->back().get_timestamp();
-    const bool in_range = first_timestamp <= last_timestamp ?
-                         (first_timestamp <= timestamp && timestamp <= last_timestamp) :
-                         (timestamp <= last_timestamp || first_timestamp <= timestamp); // Account for wrap-around
-    if (!in_range) return stream_.size(); // Timestamp out of range
-    if (timestamp == first_timestamp) return 0;
-    if (timestamp == last_timestamp) return stream_.size() - 1;
+  size_t Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::index(Iterator gof_it) const
+  {
+    return static_cast<size_t>(gof_it.it - stream_.begin());
+  }
 
-    size_t ind = stream_.size();
-    for (auto it = std::prev(this->end()); it != this->begin(); --it )
+  void Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::set_relative_timestamp(const size_t gof, const uint32_t timestamp) const
+  {
+    stream_[gof].set_timestamp(timestamp);
+    meta_.set_timestamp(gof, timestamp);
+  }
+
+  void Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::make_relative(const Timestamp& sample) const
+  {
+    if (timestamp_offset_ != 0 && sample.is_timestamp_set())
     {
-      ind--;
-      if ((*it).get_timestamp() == timestamp)
-      {
-        // Found matching timestamp return ind
-        return ind;
-      }
+      sample.set_timestamp(sample.get_timestamp() - timestamp_offset_);
     }
+  }
 
-    // Matching timestamp not found
-    return stream_.size();
+  size_t Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::find_timestamp(const uint32_t abs_timestamp) const
+  {
+    if (stream_.empty()) return 0; // No gofs yet so return first index
+
+    return meta_.find_timestamp(abs_timestamp - timestamp_offset_); // Stored timestamps are relative
   }
 
   void Sample_Stream<SAMPLE_STREAM_TYPE::NAL>::push_back(Nalu&& unit)
   {
     const auto size = unit.size();
+    total_nalu_size_ += size;
+    max_nalu_size_ = std::max(max_nalu_size_, size);
     stream_.emplace_back( size, std::move(unit));
   }
 
@@ -458,67 +590,219 @@ namespace uvgV3CRTP {
     stream_.insert(stream_.end(),
       std::make_move_iterator(other.stream_.begin()),
       std::make_move_iterator(other.stream_.end()));
+    total_nalu_size_ += other.total_nalu_size_;
+    max_nalu_size_ = std::max(max_nalu_size_, other.max_nalu_size_);
 
     // Clear other stream
     other.stream_.clear();
+    other.total_nalu_size_ = 0;
+    other.max_nalu_size_ = 0;
   }
 
 
-  std::unique_ptr<char, decltype(&free)> Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::get_bitstream() const
+  std::unique_ptr<char, decltype(&free)> Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::get_bitstream(const size_t num_threads) const
   {
     // Allocate enough memory for whole sample stream
     const size_t len = size();
     std::unique_ptr<char, decltype(&free)> bitstream((char *)malloc(len), &free);
+    write_bitstream_into(bitstream.get(), len, num_threads);
+
+    return bitstream;
+  }
+
+  std::unique_ptr<char, decltype(&free)> Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::get_bitstream(Iterator gof_it) const
+  {
+    const size_t len = size(gof_it);
+    std::unique_ptr<char, decltype(&free)> bitstream((char *)malloc(len), &free);
+    write_bitstream_into(bitstream.get(), len, gof_it);
+
+    return bitstream;
+  }
+
+  std::unique_ptr<char, decltype(&free)> Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::get_bitstream(Iterator gof_it, const V3C_UNIT_TYPE unit_type) const
+  {
+    const size_t len = size(gof_it, unit_type);
+    std::unique_ptr<char, decltype(&free)> bitstream((char *)malloc(len), &free);
+    write_bitstream_into(bitstream.get(), len, gof_it, unit_type);
+
+    return bitstream;
+  }
+
+  size_t Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::write_bitstream_into(char * const bitstream, const size_t cap, size_t num_threads) const
+  {
+    const size_t len = size();
+    if (len > cap) throw std::length_error(std::string("Error: bitstream does not fit in ") + std::to_string(cap) + " bytes in " + __func__ +
+      " at " + __FILE__ + ":" + std::to_string(__LINE__));
     size_t ptr = 0;
 
     // Insert sample stream header
-    ptr += V3C::write_size_precision(&bitstream.get()[ptr], size_precision());
+    ptr += V3C::write_size_precision(&bitstream[ptr], size_precision());
+
+    if (num_threads == 0) num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+    if (num_threads > 1 && stream_.size() > 1)
+    {
+      ptr += write_gofs_parallel(&bitstream[ptr], num_threads);
+
+      if (ptr != len) throw std::logic_error(std::string("Error: size mismatch in ") + __func__ +
+        " at " + __FILE__ + ":" + std::to_string(__LINE__));
+
+      return ptr;
+    }
 
     // Start copying data from v3c units
     for (Iterator it = stream_.begin(); it != stream_.end(); ++it)
     {
-      if (ptr + (*it).size() > len) throw std::length_error(std::string("Error: about to exceed allocated memory in ") + __func__ +
+      if (ptr + size(it) > len) throw std::length_error(std::string("Error: about to exceed allocated memory in ") + __func__ +
         " at " + __FILE__ + ":" + std::to_string(__LINE__));
       // Write current gof
-      ptr += write_bitstream(&bitstream.get()[ptr], it);
+      ptr += write_bitstream(&bitstream[ptr], it);
     }
 
     if (ptr != len) throw std::logic_error(std::string("Error: size mismatch in ") + __func__ +
       " at " + __FILE__ + ":" + std::to_string(__LINE__));
 
-    return bitstream;
+    return ptr;
   }
 
-  std::unique_ptr<char, decltype(&free)> Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::get_bitstream(Iterator gof_it) const
+  size_t Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::write_bitstream_into(char * const bitstream, const size_t cap, Iterator gof_it) const
   {
     const size_t len = size(gof_it);
-    std::unique_ptr<char, decltype(&free)> bitstream((char *)malloc(len), &free);
+    if (len > cap) throw std::length_error(std::string("Error: bitstream does not fit in ") + std::to_string(cap) + " bytes in " + __func__ +
+      " at " + __FILE__ + ":" + std::to_string(__LINE__));
 
-    size_t ptr = write_bitstream(bitstream.get(), gof_it);
+    size_t ptr = write_bitstream(bitstream, gof_it);
 
     if (ptr != len) throw std::logic_error(std::string("Error: size mismatch in ") + __func__ +
       " at " + __FILE__ + ":" + std::to_string(__LINE__));
 
-    return bitstream;
+    return ptr;
   }
 
-  std::unique_ptr<char, decltype(&free)> Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::get_bitstream(Iterator gof_it, const V3C_UNIT_TYPE unit_type) const
+  size_t Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::write_bitstream_into(char * const bitstream, const size_t cap, Iterator gof_it, const V3C_UNIT_TYPE unit_type) const
   {
     const size_t len = size(gof_it, unit_type);
-    std::unique_ptr<char, decltype(&free)> bitstream((char *)malloc(len), &free);
+    if (len > cap) throw std::length_error(std::string("Error: bitstream does not fit in ") + std::to_string(cap) + " bytes in " + __func__ +
+      " at " + __FILE__ + ":" + std::to_string(__LINE__));
 
-    size_t ptr = write_bitstream(bitstream.get(), gof_it, unit_type);
+    size_t ptr = write_bitstream(bitstream, gof_it, unit_type);
     
     if (ptr != len) throw std::logic_error(std::string("Error: size mismatch in ") + __func__ +
       " at " + __FILE__ + ":" + std::to_string(__LINE__));
 
+    return ptr;
+  }
+
+  size_t Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::size(const uint8_t size_precision, const uint8_t nal_size_precisions[NUM_V3C_UNIT_TYPES]) const
+  {
+    const uint8_t precision = target_size_precision(size_precision);
+    size_t len = SAMPLE_STREAM_HDR_LEN;
+    for (size_t i = 0; i < stream_.size(); ++i)
+    {
+      len += meta_.num_units(i) * precision + meta_.gof_size(i);
+      if (!nal_size_precisions) continue;
+      for (const auto&[type, unit] : stream_[i])
+      {
+        // Only units with rewritten nal size fields change size
+        const uint8_t nal_precision = target_nal_precision(nal_size_precisions, type);
+        if (nal_precision != 0) len = len - meta_.unit_size(i, type) + unit.size(nal_precision);
+      }
+    }
+    return len;
+  }
+
+  std::unique_ptr<char, decltype(&free)> Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::get_bitstream(const uint8_t size_precision, const uint8_t nal_size_precisions[NUM_V3C_UNIT_TYPES]) const
+  {
+    const size_t len = size(size_precision, nal_size_precisions);
+    std::unique_ptr<char, decltype(&free)> bitstream((char *)malloc(len), &free);
+    write_bitstream_into(bitstream.get(), len, size_precision, nal_size_precisions);
+
     return bitstream;
   }
 
+  size_t Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::write_bitstream_into(char * const bitstream, const size_t cap, const uint8_t size_precision, const uint8_t nal_size_precisions[NUM_V3C_UNIT_TYPES]) const
+  {
+    const size_t len = size(size_precision, nal_size_precisions);
+    if (len > cap) throw std::length_error(std::string("Error: bitstream does not fit in ") + std::to_string(cap) + " bytes in " + __func__ +
+      " at " + __FILE__ + ":" + std::to_string(__LINE__));
+
+    // Size fields are rewritten while copying, so the payloads are only touched once
+    const uint8_t precision = target_size_precision(size_precision);
+    size_t ptr = V3C::write_size_precision(bitstream, precision);
+    for (Iterator it = stream_.begin(); it != stream_.end(); ++it)
+    {
+      for (const auto&[type, unit] : *it)
+      {
+        ptr += write_bitstream(&bitstream[ptr], it, type, precision, target_nal_precision(nal_size_precisions, type));
+      }
+    }
+
+    if (ptr != len) throw std::logic_error(std::string("Error: size mismatch in ") + __func__ +
+      " at " + __FILE__ + ":" + std::to_string(__LINE__));
+
+    return ptr;
+  }
+
+  size_t Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::write_gofs_parallel(char * const bitstream, const size_t num_threads) const
+  {
+    // Unit sizes are known in advance, so the output offset of each gof is a prefix sum of gof sizes
+    std::vector<size_t> offsets(stream_.size() + 1, 0);
+    for (size_t i = 0; i < stream_.size(); ++i)
+    {
+      offsets[i + 1] = offsets[i] + size(Iterator(std::next(stream_.begin(), i)));
+    }
+
+    // Write gofs concurrently into disjoint regions. Each worker grabs the next unwritten gof so large gofs do not stall the others
+    std::atomic<size_t> next_gof{ 0 };
+    std::mutex error_mutex;
+    std::string error_msg;
+
+    const auto worker = [&]() {
+      try
+      {
+        for (size_t i = next_gof++; i < stream_.size(); i = next_gof++)
+        {
+          const size_t written = write_bitstream(&bitstream[offsets[i]], Iterator(std::next(stream_.begin(), i)));
+          if (written != offsets[i + 1] - offsets[i]) throw std::logic_error("gof size mismatch");
+        }
+      }
+      catch (const std::exception& e)
+      {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (error_msg.empty()) error_msg = e.what();
+        next_gof = stream_.size(); // Stop other workers
+      }
+    };
+
+    std::vector<std::thread> workers;
+    const size_t num_workers = std::min(num_threads, stream_.size());
+    workers.reserve(num_workers); // Only thread creation can throw below, so started threads are always joined
+    for (size_t i = 1; i < num_workers; ++i)
+    {
+      try
+      {
+        workers.emplace_back(worker);
+      }
+      catch (const std::system_error&)
+      {
+        break; // Out of threads, the already running workers share the remaining gofs
+      }
+    }
+    worker(); // Calling thread works as well
+    for (auto& thread : workers)
+    {
+      thread.join();
+    }
+
+    if (!error_msg.empty()) throw std::runtime_error(std::string("Error writing bitstream in ") + __func__ +
+      " at " + __FILE__ + ":" + std::to_string(__LINE__) + " with error: " + error_msg);
+
+    return offsets.back();
+  }
+
   size_t Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::write_bitstream(char * const bitstream, Iterator gof_it) const
   {
     size_t ptr = 0;
-    for (const auto&[type, unit] : gof_it.it->second)
+    for (const auto&[type, unit] : *gof_it)
     {
       // Write v3c unit bitstreams
       ptr += write_bitstream(&bitstream[ptr], gof_it, type);
@@ -527,32 +811,169 @@ namespace uvgV3CRTP {
   }
 
   size_t Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::write_bitstream(char * const bitstream, Iterator gof_it, V3C_UNIT_TYPE unit_type) const
+  {
+    return write_bitstream(bitstream, gof_it, unit_type, size_precision());
+  }
+
+  size_t Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::write_bitstream(char * const bitstream, Iterator gof_it, V3C_UNIT_TYPE unit_type, const uint8_t precision, const uint8_t nal_size_precision) const
   {
     size_t ptr = 0;
+    const V3C_Unit& unit = (*gof_it).get(unit_type);
+    if (nal_size_precision == 0)
+    {
+      // Insert sample stream unit size
+      const size_t unit_size = meta_.unit_size(index(gof_it), unit_type);
+      check_unit_size(unit_size, precision);
+      ptr += V3C::write_sample_stream_size(&bitstream[ptr], unit_size, precision);
 
-    // Insert sample stream unit size
-    ptr += V3C::write_sample_stream_size(&bitstream[ptr], gof_it.it->first.at(unit_type), size_precision());
+      // Write data to bitstream
+      ptr += unit.write_bitstream(&bitstream[ptr]);
+
+      return ptr;
+    }
+
+    // Unit size changes with the nal size fields
+    const size_t unit_size = unit.size(nal_size_precision);
+    check_unit_size(unit_size, precision);
+    ptr += V3C::write_sample_stream_size(&bitstream[ptr], unit_size, precision);
+    ptr += unit.write_bitstream(&bitstream[ptr], nal_size_precision);
 
-    // Write data to bitstream
-    ptr += (*gof_it).get(unit_type).write_bitstream(&bitstream[ptr]);
-    
     return ptr;
   }
 
+  std::unique_ptr<BitstreamSegment, decltype(&free)> Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::get_bitstream_segments(size_t& num_segments) const
+  {
+    return Segment_Writer::make_segments([this](Segment_Writer& writer) { write_segments(writer); }, num_segments);
+  }
+
+  std::unique_ptr<BitstreamSegment, decltype(&free)> Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::get_bitstream_segments(Iterator gof_it, size_t& num_segments) const
+  {
+    return Segment_Writer::make_segments([this, &gof_it](Segment_Writer& writer) { write_segments(writer, gof_it, size_precision()); }, num_segments);
+  }
+
+  std::unique_ptr<BitstreamSegment, decltype(&free)> Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::get_bitstream_segments(Iterator gof_it, const V3C_UNIT_TYPE unit_type, size_t& num_segments) const
+  {
+    return Segment_Writer::make_segments([this, &gof_it, unit_type](Segment_Writer& writer) { write_segments(writer, gof_it, unit_type, size_precision()); }, num_segments);
+  }
+
+  std::unique_ptr<BitstreamSegment, decltype(&free)> Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::get_bitstream_segments(Iterator gof_it, const uint8_t size_precision, size_t& num_segments) const
+  {
+    if (size_precision == 0 || size_precision > MAX_V3C_SIZE_PREC) throw std::invalid_argument("Size precision needs to be [1,8].");
+    for (const auto&[type, unit] : *gof_it)
+    {
+      check_unit_size(meta_.unit_size(index(gof_it), type), size_precision);
+    }
+    return Segment_Writer::make_segments([this, &gof_it, size_precision](Segment_Writer& writer) { write_segments(writer, gof_it, size_precision); }, num_segments);
+  }
+
+  std::unique_ptr<BitstreamSegment, decltype(&free)> Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::get_bitstream_segments(const uint8_t size_precision, const uint8_t nal_size_precisions[NUM_V3C_UNIT_TYPES], size_t& num_segments) const
+  {
+    const uint8_t precision = target_size_precision(size_precision);
+    return Segment_Writer::make_segments([this, precision, nal_size_precisions](Segment_Writer& writer)
+      {
+        V3C::write_size_precision(writer.scratch(SAMPLE_STREAM_HDR_LEN), precision);
+        for (Iterator it = stream_.begin(); it != stream_.end(); ++it)
+        {
+          for (const auto&[type, unit] : *it)
+          {
+            write_segments(writer, it, type, precision, target_nal_precision(nal_size_precisions, type));
+          }
+        }
+      }, num_segments);
+  }
+
+  std::unique_ptr<BitstreamSegment, decltype(&free)> Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::get_bitstream_segments(Iterator gof_it, const uint8_t size_precision, const uint8_t nal_size_precisions[NUM_V3C_UNIT_TYPES], size_t& num_segments) const
+  {
+    const uint8_t precision = target_size_precision(size_precision);
+    return Segment_Writer::make_segments([this, &gof_it, precision, nal_size_precisions](Segment_Writer& writer)
+      {
+        for (const auto&[type, unit] : *gof_it)
+        {
+          write_segments(writer, gof_it, type, precision, target_nal_precision(nal_size_precisions, type));
+        }
+      }, num_segments);
+  }
+
+  void Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::write_segments(Segment_Writer& writer) const
+  {
+    // Insert sample stream header
+    const uint8_t precision = size_precision();
+    V3C::write_size_precision(writer.scratch(SAMPLE_STREAM_HDR_LEN), precision);
+
+    for (Iterator it = stream_.begin(); it != stream_.end(); ++it)
+    {
+      write_segments(writer, it, precision);
+    }
+  }
+
+  void Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::write_segments(Segment_Writer& writer, Iterator gof_it, const uint8_t size_precision) const
+  {
+    for (const auto&[type, unit] : *gof_it)
+    {
+      write_segments(writer, gof_it, type, size_precision);
+    }
+  }
+
+  void Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::write_segments(Segment_Writer& writer, Iterator gof_it, V3C_UNIT_TYPE unit_type, const uint8_t precision, const uint8_t nal_size_precision) const
+  {
+    const V3C_Unit& unit = (*gof_it).get(unit_type);
+    if (nal_size_precision == 0)
+    {
+      const size_t unit_size = meta_.unit_size(index(gof_it), unit_type);
+      check_unit_size(unit_size, precision);
+      V3C::write_sample_stream_size(writer.scratch(precision), unit_size, precision);
+      unit.write_segments(writer);
+      return;
+    }
+
+    // Unit size changes with the nal size fields
+    const size_t unit_size = unit.size(nal_size_precision);
+    check_unit_size(unit_size, precision);
+    V3C::write_sample_stream_size(writer.scratch(precision), unit_size, precision);
+    unit.write_segments(writer, nal_size_precision);
+  }
+
+  void Sample_Stream<SAMPLE_STREAM_TYPE::NAL>::write_segments(Segment_Writer& writer) const
+  {
+    write_segments(writer, size_precision());
+  }
+
+  void Sample_Stream<SAMPLE_STREAM_TYPE::NAL>::write_segments(Segment_Writer& writer, const uint8_t precision) const
+  {
+    if (precision != size_precision()) check_size_precision(precision);
+    if (header_size > 0)
+    {
+      V3C::write_size_precision(writer.scratch(header_size), precision);
+    }
+
+    for (const auto&[size, data] : stream_)
+    {
+      V3C::write_sample_stream_size(writer.scratch(precision), size, precision);
+      writer.reference(reinterpret_cast<const char*>(data.bitstream()), data.size());
+    }
+  }
+
   size_t Sample_Stream<SAMPLE_STREAM_TYPE::NAL>::write_bitstream(char * const bitstream) const
   {
+    return write_bitstream(bitstream, size_precision());
+  }
+
+  size_t Sample_Stream<SAMPLE_STREAM_TYPE::NAL>::write_bitstream(char * const bitstream, const uint8_t precision) const
+  {
+    if (precision != size_precision()) check_size_precision(precision);
+
     // Insert sample stream header
     size_t ptr = 0;
     if (header_size > 0)
     {
-      ptr += V3C::write_size_precision(&bitstream[ptr], size_precision()); // TODO: check that header_size matches how much is written
+      ptr += V3C::write_size_precision(&bitstream[ptr], precision); // TODO: check that header_size matches how much is written
     }
 
     // Start copying data from nal units
     for (const auto&[size, data] : stream_)
     {
       // Insert sample stream unit size
-      ptr += V3C::write_sample_stream_size(&bitstream[ptr], size, size_precision());
+      ptr += V3C::write_sample_stream_size(&bitstream[ptr], size, precision);
 
       // Write data to bitstream
       memcpy(&bitstream[ptr], data.bitstream(), data.size());
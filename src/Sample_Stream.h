@@ -1,9 +1,10 @@
 #pragma once
 
 #include "uvgv3crtp/global.h"
-#include "V3C_Gof.h"
 //#include "V3C_Unit.h"
 #include "Nalu.h"
+#include "Segment_Writer.h"
+#include "Gof_Metadata.h"
 
 #include <map>
 #include <vector>
@@ -13,8 +14,9 @@
 
 namespace uvgV3CRTP {
    //Forward declaration
-  //class V3C_Gof;
+  class V3C_Gof; // V3C_Gof stores units in place so it includes V3C_Unit.h, which in turn needs Sample_Stream<NAL>
   class V3C_Unit;
+  class Sample_Stream_View;
 
   //Define an iterator class
   template <typename SampleType, template <typename> class StreamType>
@@ -52,15 +54,10 @@ namespace uvgV3CRTP {
   public:
     using SampleType = V3C_Gof;
     template <typename ST>
-    using StreamType = std::vector<std::pair<std::map<V3C_UNIT_TYPE, size_t>, ST>>;
+    using StreamType = std::vector<ST>; // Gof objects only, their metadata is kept in parallel arrays
     using Iterator = SampleStreamIterator<SampleType, StreamType>;
 
-    Sample_Stream(const uint8_t size_precision = static_cast<uint8_t>(-1)) : size_precision_(size_precision) 
-    {
-      if (size_precision_ > MAX_V3C_SIZE_PREC && size_precision_ != static_cast<uint8_t>(-1)) {
-        throw std::invalid_argument("Size precision needs to be [1,8] or (uint8_t)-1.");
-      }
-    }
+    Sample_Stream(const uint8_t size_precision = static_cast<uint8_t>(-1)); // Defined out of line since V3C_Gof is incomplete here
     ~Sample_Stream() = default;
 
     Sample_Stream(const Sample_Stream&) = delete;
@@ -74,6 +71,8 @@ namespace uvgV3CRTP {
     void push_back(V3C_Gof&& gof);
     void push_back(Sample_Stream<SAMPLE_STREAM_TYPE::V3C>&& other);
 
+    void add_backing_buffer(std::shared_ptr<const char[]> buffer); // Keep a buffer referenced by borrowed nalus alive for the lifetime of the stream
+
     size_t size() const;
     size_t size(Iterator gof_it) const;
     size_t size(Iterator gof_it, const V3C_UNIT_TYPE unit_type) const;
@@ -87,21 +86,72 @@ namespace uvgV3CRTP {
     const SampleType& front() const;
     const SampleType& back() const;
 
-    std::unique_ptr<char, decltype(&free)> get_bitstream() const;
+    std::unique_ptr<char, decltype(&free)> get_bitstream(const size_t num_threads = 1) const; // GoFs are written concurrently with num_threads > 1, 0 uses all hardware threads
     std::unique_ptr<char, decltype(&free)> get_bitstream(Iterator gof_it) const;
     std::unique_ptr<char, decltype(&free)> get_bitstream(Iterator gof_it, const V3C_UNIT_TYPE unit_type) const;
 
+    // Serialize into caller provided memory, cap needs to be at least the respective size(). Return number of bytes written
+    size_t write_bitstream_into(char * const bitstream, const size_t cap, const size_t num_threads = 1) const;
+    size_t write_bitstream_into(char * const bitstream, const size_t cap, Iterator gof_it) const;
+    size_t write_bitstream_into(char * const bitstream, const size_t cap, Iterator gof_it, const V3C_UNIT_TYPE unit_type) const;
+
+    // Export bitstream as segments that reference nalu payloads in place. Returned block holds the segment array followed by the scratch memory of headers and size fields
+    std::unique_ptr<BitstreamSegment, decltype(&free)> get_bitstream_segments(size_t& num_segments) const;
+    std::unique_ptr<BitstreamSegment, decltype(&free)> get_bitstream_segments(Iterator gof_it, size_t& num_segments) const;
+    std::unique_ptr<BitstreamSegment, decltype(&free)> get_bitstream_segments(Iterator gof_it, const V3C_UNIT_TYPE unit_type, size_t& num_segments) const;
+    std::unique_ptr<BitstreamSegment, decltype(&free)> get_bitstream_segments(Iterator gof_it, const uint8_t size_precision, size_t& num_segments) const; // Use given size precision instead of the stream precision
+
+    // Serialize with target precisions, rewriting size fields while copying or gathering. size_precision 0 keeps the stream precision.
+    // nal_size_precisions is indexed by unit type and may be nullptr, 0 entries keep the unit precision
+    size_t size(const uint8_t size_precision, const uint8_t nal_size_precisions[NUM_V3C_UNIT_TYPES]) const;
+    std::unique_ptr<char, decltype(&free)> get_bitstream(const uint8_t size_precision, const uint8_t nal_size_precisions[NUM_V3C_UNIT_TYPES]) const;
+    size_t write_bitstream_into(char * const bitstream, const size_t cap, const uint8_t size_precision, const uint8_t nal_size_precisions[NUM_V3C_UNIT_TYPES]) const;
+    std::unique_ptr<BitstreamSegment, decltype(&free)> get_bitstream_segments(const uint8_t size_precision, const uint8_t nal_size_precisions[NUM_V3C_UNIT_TYPES], size_t& num_segments) const;
+    std::unique_ptr<BitstreamSegment, decltype(&free)> get_bitstream_segments(Iterator gof_it, const uint8_t size_precision, const uint8_t nal_size_precisions[NUM_V3C_UNIT_TYPES], size_t& num_segments) const;
+
+    // Timestamps of gofs, units and nalus in the stream are relative to a stream level offset, so the whole stream can be rebased in O(1).
+    // Timestamps of pushed samples are absolute and converted on insertion
+    uint32_t timestamp(const Timestamp& sample) const { return sample.get_timestamp() + timestamp_offset_; } // Absolute timestamp of a gof of this stream, or of a unit or nalu resolved against its parents
+    uint32_t timestamp_offset() const { return timestamp_offset_; }
+    void rebase_timestamps(const uint32_t first_timestamp); // Shift all timestamps so that the first gof has first_timestamp
+    void set_timestamp(Iterator gof_it, const uint32_t timestamp) const; // Set the absolute timestamp of a gof and its units. Gofs of a stream should not be timestamped directly
+
+    size_t release_front(const size_t num_gofs); // Remove gofs from the start of the stream e.g. after they have been written out. Return number of gofs removed
+    Sample_Stream split_front(const size_t num_gofs); // Move gofs from the start of the stream to a new stream that shares the backing buffers
+
   protected:
     size_t write_bitstream(char * const bitstream, Iterator gof_it) const;
     size_t write_bitstream(char * const bitstream, Iterator gof_it, V3C_UNIT_TYPE unit_type) const;
+    size_t write_bitstream(char * const bitstream, Iterator gof_it, V3C_UNIT_TYPE unit_type, const uint8_t size_precision, const uint8_t nal_size_precision = 0) const;
+    size_t write_gofs_parallel(char * const bitstream, const size_t num_threads) const; // Write all gofs into disjoint regions of bitstream at prefix sum offsets
+    void write_segments(Segment_Writer& writer) const;
+    void write_segments(Segment_Writer& writer, Iterator gof_it, const uint8_t size_precision) const;
+    void write_segments(Segment_Writer& writer, Iterator gof_it, V3C_UNIT_TYPE unit_type, const uint8_t size_precision, const uint8_t nal_size_precision = 0) const;
 
     const uint8_t size_precision_;
 
+    friend Sample_Stream_View;
+
   private:
     size_t find_free_gof(const V3C_UNIT_TYPE type) const;
-    size_t find_timestamp(const uint32_t timestamp) const;
+    size_t find_timestamp(const uint32_t abs_timestamp) const;
+    void set_unit_size(const size_t gof, const V3C_UNIT_TYPE type, const size_t unit_size); // Update gof metadata and running totals
+    void set_relative_timestamp(const size_t gof, const uint32_t timestamp) const;
+    size_t index(Iterator gof_it) const; // Position of a gof in stream_ and meta_
+    uint8_t target_size_precision(const uint8_t size_precision) const; // Resolve requested precision, 0 keeps the stream precision
+    void make_relative(const Timestamp& sample) const; // Convert an absolute timestamp of a sample being inserted to the stream offset
 
     StreamType<SampleType> stream_;
+    Gof_Metadata meta_; // Sizes, unit types and timestamps of stream_ gofs by index
+    std::vector<std::shared_ptr<const char[]>> backing_buffers_;
+
+    // Running totals so size queries do not need to iterate the stream
+    size_t total_unit_size_ = 0; // Sum of v3c unit sizes excluding sample stream size fields
+    size_t num_units_ = 0;
+    mutable size_t max_gof_size_ = 0; // Largest sum of v3c unit sizes in a gof, used to infer size precision
+    mutable bool max_gof_size_stale_ = false; // Set when the largest gof shrinks, max is recalculated on demand
+
+    uint32_t timestamp_offset_ = 0; // Added to stored timestamps, wraps around like rtp timestamps
   };
 
   template <>
@@ -131,6 +181,7 @@ namespace uvgV3CRTP {
     void push_back(Sample_Stream<SAMPLE_STREAM_TYPE::NAL>&& other);
 
     size_t size() const;
+    size_t size(const uint8_t size_precision) const; // Size when written with the given size precision
     size_t num_samples() const;
 
     uint8_t size_precision() const; // Inferred if size_precision_ == (uint8_t)-1
@@ -147,12 +198,20 @@ namespace uvgV3CRTP {
     //friend size_t V3C_Unit::write_bitstream(char* const bitstream);
     friend class V3C_Unit;
     size_t write_bitstream(char * const bitstream) const;
+    size_t write_bitstream(char * const bitstream, const uint8_t size_precision) const; // Rewrite size fields with the given precision
+    void write_segments(Segment_Writer& writer) const;
+    void write_segments(Segment_Writer& writer, const uint8_t size_precision) const;
 
     const uint8_t size_precision_;
 
   private:
+    void check_size_precision(const uint8_t size_precision) const; // Throw if nalus do not fit the precision
+
     StreamType<SampleType> stream_;
 
+    // Running totals so size queries do not need to iterate the stream
+    size_t total_nalu_size_ = 0;
+    size_t max_nalu_size_ = 0;
   };
 
   // Explicitly define necessary instantiations so code is linked properly
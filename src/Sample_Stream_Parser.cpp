@@ -0,0 +1,146 @@
+#include "Sample_Stream_Parser.h"
+
+#include "V3C.h"
+#include "V3C_Unit.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace uvgV3CRTP {
+
+  size_t Sample_Stream_Parser::parse_chunk(const char * const chunk, const size_t len, Sample_Stream<SAMPLE_STREAM_TYPE::V3C>& out, const INIT_FLAGS unit_filter)
+  {
+    if (failed_)
+    {
+      throw ParseException(
+        std::string("Error parsing chunk in ") + __func__ +
+        " at " + __FILE__ + ":" + std::to_string(__LINE__) + " with error: parser failed on an earlier chunk, reset to start a new sample stream"
+      );
+    }
+
+    size_t ptr = 0;
+    size_t num_units = 0;
+
+    // First byte should be the v3c sample stream header
+    if (size_precision_ == 0)
+    {
+      if (len == 0) return 0;
+      const uint8_t precision = V3C::parse_size_precision(chunk);
+      if (!(0 < precision && precision <= MAX_V3C_SIZE_PREC))
+      {
+        throw ParseException(
+          std::string("Error parsing chunk in ") + __func__ +
+          " at " + __FILE__ + ":" + std::to_string(__LINE__) + " with error: sample stream precision should be in range[1, 8]"
+        );
+      }
+      size_precision_ = precision;
+      ptr += SAMPLE_STREAM_HDR_LEN;
+    }
+
+    try
+    {
+      while (ptr < len)
+      {
+        if (unit_size_ == 0)
+        {
+          // Collect the V3C unit size, which may be split between chunks
+          const size_t num_size_bytes = std::min<size_t>(size_precision_ - size_field_len_, len - ptr);
+          std::memcpy(&size_field_[size_field_len_], &chunk[ptr], num_size_bytes);
+          size_field_len_ += num_size_bytes;
+          ptr += num_size_bytes;
+          if (size_field_len_ < size_precision_) break;
+
+          const size_t v3c_size = V3C::parse_sample_stream_size(size_field_.data(), size_precision_);
+          size_field_len_ = 0;
+          if (v3c_size == 0)
+          {
+            throw ParseException("V3C unit size is zero");
+          }
+
+          // Whole unit is in this chunk so parse it directly without buffering
+          if (len - ptr >= v3c_size)
+          {
+            if (!V3C::is_filtered_unit(&chunk[ptr], v3c_size, unit_filter))
+            {
+              out.push_back(V3C_Unit(&chunk[ptr], v3c_size));
+              ++num_units;
+            }
+            ptr += v3c_size;
+            continue;
+          }
+
+          unit_size_ = v3c_size;
+          unit_len_ = 0;
+        }
+
+        if (unit_len_ == 0)
+        {
+          // First byte of the unit holds the type, so a filtered unit is skipped before allocating a buffer for it
+          skip_unit_ = V3C::is_filtered_unit(&chunk[ptr], unit_size_, unit_filter);
+          if (!skip_unit_) unit_buf_ = std::shared_ptr<char[]>(new char[unit_size_]);
+        }
+
+        // Continue filling the partial unit
+        const size_t num_unit_bytes = std::min(unit_size_ - unit_len_, len - ptr);
+        if (!skip_unit_) std::memcpy(&unit_buf_[unit_len_], &chunk[ptr], num_unit_bytes);
+        unit_len_ += num_unit_bytes;
+        ptr += num_unit_bytes;
+
+        if (unit_len_ == unit_size_)
+        {
+          if (!skip_unit_)
+          {
+            // Unit complete, nalus reference the buffer directly. The unit owns it, so it is freed with the unit instead of the whole stream
+            out.push_back(V3C_Unit(std::shared_ptr<const char[]>(std::move(unit_buf_)), unit_size_));
+            ++num_units;
+          }
+          drop_pending();
+        }
+      }
+    }
+    catch (const std::exception& e)
+    {
+      // Position in the stream is lost after an error. Keep the precision so the stream is not silently reparsed from a new header, but reject further chunks
+      drop_pending();
+      failed_ = true;
+      throw ParseException(
+        std::string("Error parsing chunk in ") + __func__ +
+        " at " + __FILE__ + ":" + std::to_string(__LINE__) + " with error: " + e.what()
+      );
+    }
+
+    return num_units;
+  }
+
+  uint8_t Sample_Stream_Parser::size_precision() const
+  {
+    return size_precision_;
+  }
+
+  size_t Sample_Stream_Parser::num_pending_bytes() const
+  {
+    return size_field_len_ + unit_len_;
+  }
+
+  bool Sample_Stream_Parser::failed() const
+  {
+    return failed_;
+  }
+
+  void Sample_Stream_Parser::reset()
+  {
+    size_precision_ = 0;
+    failed_ = false;
+    drop_pending();
+  }
+
+  void Sample_Stream_Parser::drop_pending()
+  {
+    size_field_len_ = 0;
+    unit_buf_ = nullptr;
+    unit_size_ = 0;
+    unit_len_ = 0;
+    skip_unit_ = false;
+  }
+
+}
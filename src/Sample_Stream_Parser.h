@@ -0,0 +1,52 @@
+#pragma once
+
+#include "uvgv3crtp/global.h"
+#include "Sample_Stream.h"
+
+#include <array>
+#include <memory>
+#include <cstddef>
+
+namespace uvgV3CRTP {
+
+  // Incremental parser for a V3C sample stream that arrives in arbitrary sized chunks
+  class Sample_Stream_Parser
+  {
+  public:
+    Sample_Stream_Parser() = default;
+    ~Sample_Stream_Parser() = default;
+
+    Sample_Stream_Parser(const Sample_Stream_Parser&) = delete;
+    Sample_Stream_Parser& operator=(const Sample_Stream_Parser&) = delete;
+
+    Sample_Stream_Parser(Sample_Stream_Parser&&) = default;
+    Sample_Stream_Parser& operator=(Sample_Stream_Parser&&) = default;
+
+    // Parse the next chunk and push each completed V3C unit to out. The first chunk needs to start with the sample stream header. Return number of units pushed.
+    // Throws ParseException on malformed input, after which the parser is failed and rejects chunks until reset.
+    // Unit types not in unit_filter are skipped without buffering or parsing them
+    size_t parse_chunk(const char * const chunk, const size_t len, Sample_Stream<SAMPLE_STREAM_TYPE::V3C>& out, const INIT_FLAGS unit_filter = INIT_FLAGS::ALL);
+
+    uint8_t size_precision() const; // 0 until the sample stream header has been parsed
+    size_t num_pending_bytes() const; // Bytes of an incomplete size field or V3C unit buffered from previous chunks
+    bool failed() const; // True after a parse error. Position in the stream is lost so later chunks cannot be parsed
+    void reset();
+
+  private:
+    void drop_pending(); // Drop the partial size field and V3C unit
+
+    uint8_t size_precision_ = 0;
+    bool failed_ = false;
+
+    // Partial V3C unit size field
+    std::array<char, MAX_V3C_SIZE_PREC> size_field_ = {};
+    size_t size_field_len_ = 0;
+
+    // Partial V3C unit. Buffer is handed over to the unit once complete
+    std::shared_ptr<char[]> unit_buf_;
+    size_t unit_size_ = 0; // 0 if not inside a unit
+    size_t unit_len_ = 0;
+    bool skip_unit_ = false; // Unit is filtered out so its bytes are only counted
+  };
+
+}
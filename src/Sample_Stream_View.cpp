@@ -0,0 +1,120 @@
+#include "Sample_Stream_View.h"
+
+#include "V3C.h"
+#include "V3C_Gof.h"
+#include "V3C_Unit.h"
+
+#include <algorithm>
+#include <vector>
+#include <stdexcept>
+#include <string>
+
+namespace uvgV3CRTP {
+
+  Sample_Stream_View::Sample_Stream_View(const Sample_Stream<SAMPLE_STREAM_TYPE::V3C>& stream, const INIT_FLAGS unit_filter) :
+    stream_(stream),
+    unit_filter_(unit_filter),
+    filter_mask_(static_cast<uint8_t>(static_cast<uint16_t>(unit_filter) & ((1u << NUM_V3C_UNIT_TYPES) - 1)))
+  {
+    // Only the gof metadata is read, units are not touched
+    const Gof_Metadata& meta = stream_.meta_;
+    std::vector<size_t> gof_sizes(meta.size(), 0);
+    for (int type = 0; type < NUM_V3C_UNIT_TYPES; ++type)
+    {
+      if (!is_selected(static_cast<V3C_UNIT_TYPE>(type))) continue;
+      const auto& unit_sizes = meta.unit_sizes(static_cast<V3C_UNIT_TYPE>(type));
+      for (size_t i = 0; i < unit_sizes.size(); ++i)
+      {
+        gof_sizes[i] += unit_sizes[i];
+        num_units_ += meta.has_unit(i, static_cast<V3C_UNIT_TYPE>(type));
+      }
+    }
+    for (const size_t gof_size : gof_sizes)
+    {
+      total_unit_size_ += gof_size;
+      max_gof_size_ = std::max(max_gof_size_, gof_size);
+    }
+  }
+
+  bool Sample_Stream_View::is_selected(const V3C_UNIT_TYPE type) const
+  {
+    return type >= 0 && type < NUM_V3C_UNIT_TYPES && is_set(unit_filter_, static_cast<INIT_FLAGS>(1 << type));
+  }
+
+  uint8_t Sample_Stream_View::size_precision() const
+  {
+    const uint8_t precision = stream_.size_precision_;
+    return precision != static_cast<uint8_t>(-1) ? precision : V3C::min_size_precision(max_gof_size_);
+  }
+
+  size_t Sample_Stream_View::size() const
+  {
+    return SAMPLE_STREAM_HDR_LEN + num_units_ * size_precision() + total_unit_size_;
+  }
+
+  size_t Sample_Stream_View::size(Iterator gof_it) const
+  {
+    const Gof_Metadata& meta = stream_.meta_;
+    const size_t gof = stream_.index(gof_it);
+    size_t gof_size = 0;
+    for (int type = 0; type < NUM_V3C_UNIT_TYPES; ++type)
+    {
+      if (meta.has_unit(gof, static_cast<V3C_UNIT_TYPE>(type)) && is_selected(static_cast<V3C_UNIT_TYPE>(type)))
+      {
+        gof_size += size_precision() + meta.unit_size(gof, static_cast<V3C_UNIT_TYPE>(type));
+      }
+    }
+    return gof_size;
+  }
+
+  std::unique_ptr<char, decltype(&free)> Sample_Stream_View::get_bitstream() const
+  {
+    const size_t len = size();
+    std::unique_ptr<char, decltype(&free)> bitstream((char *)malloc(len), &free);
+    if (!bitstream) throw std::bad_alloc();
+    write_bitstream_into(bitstream.get(), len);
+
+    return bitstream;
+  }
+
+  size_t Sample_Stream_View::write_bitstream_into(char * const bitstream, const size_t cap) const
+  {
+    const size_t len = size();
+    if (len > cap) throw std::length_error(std::string("Error: bitstream does not fit in ") + std::to_string(cap) + " bytes in " + __func__ +
+      " at " + __FILE__ + ":" + std::to_string(__LINE__));
+
+    const uint8_t precision = size_precision();
+    size_t ptr = V3C::write_size_precision(bitstream, precision);
+
+    for (Iterator it = begin(); it != end(); ++it)
+    {
+      for (const V3C_Unit& unit : units(it))
+      {
+        ptr += stream_.write_bitstream(&bitstream[ptr], it, unit.type(), precision);
+      }
+    }
+
+    if (ptr != len) throw std::logic_error(std::string("Error: size mismatch in ") + __func__ +
+      " at " + __FILE__ + ":" + std::to_string(__LINE__));
+
+    return ptr;
+  }
+
+  std::unique_ptr<BitstreamSegment, decltype(&free)> Sample_Stream_View::get_bitstream_segments(size_t& num_segments) const
+  {
+    return Segment_Writer::make_segments([this](Segment_Writer& writer)
+      {
+        const uint8_t precision = size_precision();
+        V3C::write_size_precision(writer.scratch(SAMPLE_STREAM_HDR_LEN), precision);
+
+        for (Iterator it = begin(); it != end(); ++it)
+        {
+          for (const V3C_Unit& unit : units(it))
+          {
+            stream_.write_segments(writer, it, unit.type(), precision);
+          }
+        }
+      }, num_segments);
+  }
+
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "uvgv3crtp/global.h"
+#include "Sample_Stream.h"
+#include "V3C_Gof.h"
+
+#include <iterator>
+#include <memory>
+#include <cstdlib>
+
+namespace uvgV3CRTP {
+
+  // Read-only view of the v3c units of selected types in a sample stream. Units are referenced in place, so the stream needs to outlive the view.
+  // Sizes are calculated when the view is created, so a view needs to be recreated if the stream is modified
+  class Sample_Stream_View
+  {
+  public:
+    using Iterator = Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::Iterator;
+
+    // Selected units of a gof in type order. Walks the presence bits of the gof, so nothing is allocated
+    class Unit_Range
+    {
+    public:
+      class iterator
+      {
+      public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = V3C_Unit;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const V3C_Unit*;
+        using reference = const V3C_Unit&;
+
+        iterator(const V3C_Gof* gof, uint8_t mask) : gof_(gof), mask_(mask) {}
+
+        reference operator*() const { return gof_->get(type()); }
+        pointer operator->() const { return &gof_->get(type()); }
+        iterator& operator++() { mask_ &= mask_ - 1; return *this; }
+        iterator operator++(int) { iterator tmp = *this; ++(*this); return tmp; }
+        bool operator==(const iterator& other) const { return mask_ == other.mask_ && gof_ == other.gof_; }
+        bool operator!=(const iterator& other) const { return !(*this == other); }
+
+        V3C_UNIT_TYPE type() const // Type of the lowest remaining bit
+        {
+          int type = 0;
+          while (!(mask_ & (1u << type))) ++type;
+          return static_cast<V3C_UNIT_TYPE>(type);
+        }
+
+      private:
+        const V3C_Gof* gof_;
+        uint8_t mask_;
+      };
+
+      Unit_Range(const V3C_Gof& gof, uint8_t mask) : gof_(gof), mask_(mask) {}
+
+      iterator begin() const { return iterator(&gof_, mask_); }
+      iterator end() const { return iterator(&gof_, 0); }
+      bool empty() const { return mask_ == 0; }
+      size_t size() const
+      {
+        size_t num = 0;
+        for (uint8_t mask = mask_; mask; mask &= mask - 1) ++num;
+        return num;
+      }
+
+    private:
+      const V3C_Gof& gof_;
+      const uint8_t mask_;
+    };
+
+    Sample_Stream_View(const Sample_Stream<SAMPLE_STREAM_TYPE::V3C>& stream, const INIT_FLAGS unit_filter);
+    ~Sample_Stream_View() = default;
+
+    const Sample_Stream<SAMPLE_STREAM_TYPE::V3C>& stream() const { return stream_; }
+    INIT_FLAGS unit_filter() const { return unit_filter_; }
+    bool is_selected(const V3C_UNIT_TYPE type) const;
+
+    // Gofs of the underlying stream, use units() to get the selected units of a gof
+    Iterator begin() const { return stream_.begin(); }
+    Iterator end() const { return stream_.end(); }
+    Unit_Range units(Iterator gof_it) const { return Unit_Range(*gof_it, (*gof_it).unit_mask() & filter_mask_); }
+
+    size_t size() const; // Size of the sample stream of the selected units
+    size_t size(Iterator gof_it) const;
+    size_t num_units() const { return num_units_; }
+    uint8_t size_precision() const; // Inferred from the selected units if the stream precision is (uint8_t)-1
+
+    std::unique_ptr<char, decltype(&free)> get_bitstream() const;
+    size_t write_bitstream_into(char * const bitstream, const size_t cap) const; // Return number of bytes written
+    std::unique_ptr<BitstreamSegment, decltype(&free)> get_bitstream_segments(size_t& num_segments) const;
+
+  private:
+    const Sample_Stream<SAMPLE_STREAM_TYPE::V3C>& stream_;
+    const INIT_FLAGS unit_filter_;
+    const uint8_t filter_mask_; // Bit n is set if type n is selected, same layout as the gof unit mask
+
+    size_t total_unit_size_ = 0; // Sum of selected v3c unit sizes excluding sample stream size fields
+    size_t num_units_ = 0;
+    size_t max_gof_size_ = 0; // Largest sum of selected v3c unit sizes in a gof
+  };
+
+}
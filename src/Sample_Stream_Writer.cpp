@@ -0,0 +1,257 @@
+#include "Sample_Stream_Writer.h"
+
+#include "V3C.h"
+#include "V3C_Gof.h"
+#include "V3C_Unit.h"
+
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <cerrno>
+#include <cstring>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#include <sys/uio.h>
+#include <climits>
+#endif
+
+namespace uvgV3CRTP {
+
+  static std::runtime_error io_error(const std::string& msg)
+  {
+    return std::runtime_error("Error writing sample stream: " + msg + " (" + std::strerror(errno) + ")");
+  }
+
+  // Positioned read/write helpers, offsets are from the start of the file
+  static void read_at(const int fd, char * const data, const size_t len, const size_t offset)
+  {
+    for (size_t done = 0; done < len;)
+    {
+#ifdef _WIN32
+      if (_lseeki64(fd, static_cast<__int64>(offset + done), SEEK_SET) < 0) throw io_error("seek failed");
+      const int ret = _read(fd, &data[done], static_cast<unsigned>(std::min<size_t>(len - done, INT_MAX)));
+#else
+      const ssize_t ret = pread(fd, &data[done], len - done, static_cast<off_t>(offset + done));
+#endif
+      if (ret <= 0) throw io_error("read failed");
+      done += static_cast<size_t>(ret);
+    }
+  }
+
+  static void write_at(const int fd, const char * const data, const size_t len, const size_t offset)
+  {
+    for (size_t done = 0; done < len;)
+    {
+#ifdef _WIN32
+      if (_lseeki64(fd, static_cast<__int64>(offset + done), SEEK_SET) < 0) throw io_error("seek failed");
+      const int ret = _write(fd, &data[done], static_cast<unsigned>(std::min<size_t>(len - done, INT_MAX)));
+#else
+      const ssize_t ret = pwrite(fd, &data[done], len - done, static_cast<off_t>(offset + done));
+#endif
+      if (ret <= 0) throw io_error("write failed");
+      done += static_cast<size_t>(ret);
+    }
+  }
+
+  Sample_Stream_Writer::Sample_Stream_Writer(const int fd, const uint8_t size_precision, const uint8_t nal_size_precisions[NUM_V3C_UNIT_TYPES]) :
+    fd_(fd),
+    infer_precision_(size_precision == static_cast<uint8_t>(-1)),
+    write_precision_(infer_precision_ ? MAX_V3C_SIZE_PREC : size_precision)
+  {
+    if (nal_size_precisions) std::copy(nal_size_precisions, nal_size_precisions + NUM_V3C_UNIT_TYPES, nal_size_precisions_.begin());
+    if (fd_ < 0) throw std::invalid_argument("Invalid file descriptor");
+#ifdef _WIN32
+    const __int64 offset = _lseeki64(fd_, 0, SEEK_CUR);
+#else
+    const off_t offset = lseek(fd_, 0, SEEK_CUR);
+#endif
+    if (offset < 0 && infer_precision_) throw std::invalid_argument("File descriptor needs to be seekable to infer size precision");
+    base_offset_ = offset > 0 ? static_cast<size_t>(offset) : 0;
+    write_header(write_precision_);
+  }
+
+  Sample_Stream_Writer::Sample_Stream_Writer(std::ostream& out, const uint8_t size_precision, const uint8_t nal_size_precisions[NUM_V3C_UNIT_TYPES]) :
+    out_(&out),
+    infer_precision_(false),
+    write_precision_(size_precision)
+  {
+    if (nal_size_precisions) std::copy(nal_size_precisions, nal_size_precisions + NUM_V3C_UNIT_TYPES, nal_size_precisions_.begin());
+    if (size_precision == static_cast<uint8_t>(-1)) throw std::invalid_argument("Size precision cannot be inferred when writing to a std::ostream");
+    write_header(write_precision_);
+  }
+
+  void Sample_Stream_Writer::write_header(const uint8_t precision)
+  {
+    if (precision == 0 || precision > MAX_V3C_SIZE_PREC) throw std::invalid_argument("Size precision needs to be [1,8] or (uint8_t)-1.");
+
+    char header[SAMPLE_STREAM_HDR_LEN] = {};
+    V3C::write_size_precision(header, precision);
+    const BitstreamSegment segment = { header, SAMPLE_STREAM_HDR_LEN };
+    write(&segment, 1);
+  }
+
+  size_t Sample_Stream_Writer::write_gof(const Sample_Stream<SAMPLE_STREAM_TYPE::V3C>& stream, Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::Iterator gof_it)
+  {
+    if (finished_) throw std::logic_error("Cannot write gofs after finish()");
+
+    size_t num_segments = 0;
+    const auto segments = stream.get_bitstream_segments(gof_it, write_precision_, nal_size_precisions_.data(), num_segments);
+
+    const size_t start = bytes_written_;
+    write(segments.get(), num_segments);
+
+    for (const auto&[type, unit] : *gof_it)
+    {
+      max_unit_size_ = std::max(max_unit_size_, unit.size(nal_size_precisions_[type]));
+    }
+    ++num_gofs_written_;
+
+    return bytes_written_ - start;
+  }
+
+  size_t Sample_Stream_Writer::write_unit(const char * const unit, const size_t len)
+  {
+    if (finished_) throw std::logic_error("Cannot write units after finish()");
+    if (write_precision_ < MAX_V3C_SIZE_PREC && (len >> (write_precision_ * SIZE_PREC_MULT)) != 0)
+    {
+      throw std::length_error("V3C unit of " + std::to_string(len) + " bytes does not fit size precision " + std::to_string(write_precision_));
+    }
+
+    char size_field[MAX_V3C_SIZE_PREC] = {};
+    V3C::write_sample_stream_size(size_field, len, write_precision_);
+    const BitstreamSegment segments[] = { { size_field, write_precision_ }, { unit, len } };
+
+    const size_t start = bytes_written_;
+    write(segments, 2);
+    max_unit_size_ = std::max(max_unit_size_, len);
+
+    return bytes_written_ - start;
+  }
+
+  void Sample_Stream_Writer::write(const BitstreamSegment * const segments, const size_t num_segments)
+  {
+    if (out_)
+    {
+      for (size_t i = 0; i < num_segments; ++i)
+      {
+        out_->write(static_cast<const char*>(segments[i].base), static_cast<std::streamsize>(segments[i].len));
+        bytes_written_ += segments[i].len;
+      }
+      if (!*out_) throw std::runtime_error("Error writing sample stream: output stream failed");
+      return;
+    }
+
+#ifdef _WIN32
+    for (size_t i = 0; i < num_segments; ++i)
+    {
+      write_at(fd_, static_cast<const char*>(segments[i].base), segments[i].len, base_offset_ + bytes_written_);
+      bytes_written_ += segments[i].len;
+    }
+#else
+    // Write segments in batches, handling partial writes by advancing within the current batch
+    std::vector<iovec> batch;
+    for (size_t first = 0; first < num_segments;)
+    {
+      const size_t count = std::min<size_t>(num_segments - first, IOV_MAX);
+      batch.assign(reinterpret_cast<const iovec*>(&segments[first]), reinterpret_cast<const iovec*>(&segments[first + count]));
+
+      size_t ind = 0;
+      while (ind < batch.size())
+      {
+        const ssize_t ret = writev(fd_, &batch[ind], static_cast<int>(batch.size() - ind));
+        if (ret < 0)
+        {
+          if (errno == EINTR) continue;
+          throw io_error("writev failed");
+        }
+        bytes_written_ += static_cast<size_t>(ret);
+
+        size_t left = static_cast<size_t>(ret);
+        while (ind < batch.size() && left >= batch[ind].iov_len)
+        {
+          left -= batch[ind].iov_len;
+          ++ind;
+        }
+        if (left > 0)
+        {
+          batch[ind].iov_base = static_cast<char*>(batch[ind].iov_base) + left;
+          batch[ind].iov_len -= left;
+        }
+      }
+      first += count;
+    }
+#endif
+  }
+
+  void Sample_Stream_Writer::finish()
+  {
+    if (finished_) return;
+    finished_ = true;
+
+    if (out_)
+    {
+      out_->flush();
+      return;
+    }
+    if (infer_precision_)
+    {
+      compact(V3C::min_size_precision(max_unit_size_));
+    }
+  }
+
+  uint8_t Sample_Stream_Writer::size_precision() const
+  {
+    return (infer_precision_ && finished_) ? V3C::min_size_precision(max_unit_size_) : write_precision_;
+  }
+
+  void Sample_Stream_Writer::compact(const uint8_t precision)
+  {
+    if (precision == write_precision_) return;
+
+    // Output only shrinks, so copying forward in place never overwrites unread data
+    static constexpr size_t COPY_CHUNK_SIZE = 1 << 16;
+    std::unique_ptr<char[]> chunk(new char[COPY_CHUNK_SIZE]);
+
+    size_t read_ptr = SAMPLE_STREAM_HDR_LEN;
+    size_t write_ptr = SAMPLE_STREAM_HDR_LEN;
+    while (read_ptr < bytes_written_)
+    {
+      char size_field[MAX_V3C_SIZE_PREC] = {};
+      read_at(fd_, size_field, write_precision_, base_offset_ + read_ptr);
+      const size_t unit_size = V3C::parse_sample_stream_size(size_field, write_precision_);
+      read_ptr += write_precision_;
+
+      write_ptr += V3C::write_sample_stream_size(size_field, unit_size, precision);
+      write_at(fd_, size_field, precision, base_offset_ + write_ptr - precision);
+
+      for (size_t done = 0; done < unit_size;)
+      {
+        const size_t len = std::min(COPY_CHUNK_SIZE, unit_size - done);
+        read_at(fd_, chunk.get(), len, base_offset_ + read_ptr + done);
+        write_at(fd_, chunk.get(), len, base_offset_ + write_ptr + done);
+        done += len;
+      }
+      read_ptr += unit_size;
+      write_ptr += unit_size;
+    }
+
+    // Back-patch the sample stream header and drop the now unused tail
+    char header[SAMPLE_STREAM_HDR_LEN] = {};
+    V3C::write_size_precision(header, precision);
+    write_at(fd_, header, SAMPLE_STREAM_HDR_LEN, base_offset_);
+#ifdef _WIN32
+    if (_chsize_s(fd_, static_cast<__int64>(base_offset_ + write_ptr)) != 0) throw io_error("truncate failed");
+    _lseeki64(fd_, static_cast<__int64>(base_offset_ + write_ptr), SEEK_SET);
+#else
+    if (ftruncate(fd_, static_cast<off_t>(base_offset_ + write_ptr)) != 0) throw io_error("truncate failed");
+    lseek(fd_, static_cast<off_t>(base_offset_ + write_ptr), SEEK_SET);
+#endif
+    bytes_written_ = write_ptr;
+  }
+
+}
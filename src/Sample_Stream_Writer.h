@@ -0,0 +1,52 @@
+#pragma once
+
+#include "uvgv3crtp/global.h"
+#include "Sample_Stream.h"
+
+#include <ostream>
+#include <cstddef>
+#include <array>
+
+namespace uvgV3CRTP {
+
+  // Writes a V3C sample stream to a file descriptor or an output stream one GoF at a time, so the whole bitstream never needs to be in memory
+  class Sample_Stream_Writer
+  {
+  public:
+    // With size_precision (uint8_t)-1 units are written with max precision size fields and the file is compacted in finish(). fd needs to be readable and seekable in that case.
+    // nal_size_precisions (indexed by unit type, 0 keeps the unit precision) rewrites nal size fields while writing
+    Sample_Stream_Writer(const int fd, const uint8_t size_precision = static_cast<uint8_t>(-1), const uint8_t nal_size_precisions[NUM_V3C_UNIT_TYPES] = nullptr);
+    Sample_Stream_Writer(std::ostream& out, const uint8_t size_precision, const uint8_t nal_size_precisions[NUM_V3C_UNIT_TYPES] = nullptr); // Size precision needs to be fixed, output is never read back
+    ~Sample_Stream_Writer() = default;
+
+    Sample_Stream_Writer(const Sample_Stream_Writer&) = delete;
+    Sample_Stream_Writer& operator=(const Sample_Stream_Writer&) = delete;
+
+    size_t write_gof(const Sample_Stream<SAMPLE_STREAM_TYPE::V3C>& stream, Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::Iterator gof_it); // Return number of bytes written
+    size_t write_unit(const char * const unit, const size_t len); // Write a serialized V3C unit (header and payload) e.g. a repeated parameter set. Return number of bytes written
+    void finish(); // Back-patch size precision if it was inferred. No more gofs can be written after this
+
+    size_t bytes_written() const { return bytes_written_; }
+    size_t num_gofs_written() const { return num_gofs_written_; }
+    uint8_t size_precision() const; // Precision of the finished output
+
+  private:
+    void write_header(const uint8_t precision);
+    void write(const BitstreamSegment * const segments, const size_t num_segments);
+    void compact(const uint8_t precision); // Rewrite max precision size fields with precision in place
+
+    const int fd_ = -1;
+    std::ostream * const out_ = nullptr;
+    size_t base_offset_ = 0; // File offset of the sample stream header
+
+    const bool infer_precision_;
+    const uint8_t write_precision_; // Precision of the size fields as written
+    std::array<uint8_t, NUM_V3C_UNIT_TYPES> nal_size_precisions_ = {};
+    size_t max_unit_size_ = 0;
+
+    size_t bytes_written_ = 0;
+    size_t num_gofs_written_ = 0;
+    bool finished_ = false;
+  };
+
+}
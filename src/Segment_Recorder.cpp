@@ -0,0 +1,252 @@
+#include "Segment_Recorder.h"
+
+#include "V3C_Gof.h"
+#include "V3C_Unit.h"
+
+#include <cstdio>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+
+#include <fcntl.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace uvgV3CRTP {
+
+  static std::string segment_file_name(const std::string& path_prefix, const size_t ind)
+  {
+    char suffix[32] = {};
+    std::snprintf(suffix, sizeof(suffix), "%06zu.v3c", ind);
+    return path_prefix + suffix;
+  }
+
+  Segment_Recorder::Segment_Recorder(const std::string& path_prefix, const size_t gofs_per_segment, const uint8_t size_precision, const size_t max_queued_gofs) :
+    path_prefix_(path_prefix),
+    gofs_per_segment_(gofs_per_segment),
+    size_precision_(size_precision),
+    max_queued_gofs_(max_queued_gofs)
+  {
+    if (gofs_per_segment_ == 0) throw std::invalid_argument("Segments need to contain at least one gof");
+    if (size_precision_ != static_cast<uint8_t>(-1) && (size_precision_ == 0 || size_precision_ > MAX_V3C_SIZE_PREC))
+    {
+      throw std::invalid_argument("Size precision needs to be [1,8] or (uint8_t)-1.");
+    }
+    thread_ = std::thread(&Segment_Recorder::run, this);
+  }
+
+  Segment_Recorder::~Segment_Recorder()
+  {
+    try
+    {
+      finish();
+    }
+    catch (...)
+    {
+      // Errors can only be reported through push() or finish()
+    }
+  }
+
+  void Segment_Recorder::push(Sample_Stream<SAMPLE_STREAM_TYPE::V3C>&& gofs)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (error_) std::rethrow_exception(error_);
+    if (stop_) throw std::logic_error("Cannot push gofs after finish()");
+    if (gofs.num_samples() == 0) return;
+
+    // Wait for the writer if disk I/O falls behind so memory stays bounded. An empty queue always takes the gofs so a batch larger than the limit cannot block forever
+    const size_t num_gofs = gofs.num_samples();
+    space_cond_.wait(lock, [&] {
+      return error_ || max_queued_gofs_ == 0 || queue_.empty() || num_queued_gofs_ + num_gofs <= max_queued_gofs_;
+    });
+    if (error_) std::rethrow_exception(error_);
+
+    num_queued_gofs_ += num_gofs;
+    queue_.push_back(std::move(gofs));
+    lock.unlock();
+    cond_.notify_one();
+  }
+
+  void Segment_Recorder::finish()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!finished_)
+      {
+        finished_ = true;
+        stop_ = true;
+      }
+    }
+    cond_.notify_one();
+    if (thread_.joinable()) thread_.join();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (error_) std::rethrow_exception(error_);
+  }
+
+  std::vector<Segment_Info> Segment_Recorder::segments() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return segments_;
+  }
+
+  void Segment_Recorder::run()
+  {
+    try
+    {
+      while (true)
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+        if (queue_.empty()) break; // Only when stopping
+
+        Sample_Stream<SAMPLE_STREAM_TYPE::V3C> gofs(std::move(queue_.front()));
+        queue_.pop_front();
+        lock.unlock();
+
+        write_gofs(gofs);
+
+        lock.lock();
+        num_queued_gofs_ -= gofs.num_samples();
+        lock.unlock();
+        space_cond_.notify_all();
+      }
+      if (writer_) close_segment();
+    }
+    catch (...)
+    {
+      if (fd_ >= 0)
+      {
+#ifdef _WIN32
+        _close(fd_);
+#else
+        close(fd_);
+#endif
+        fd_ = -1;
+      }
+      writer_.reset();
+
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        error_ = std::current_exception();
+      }
+      space_cond_.notify_all(); // Wake a blocked push() to report the error
+    }
+  }
+
+  void Segment_Recorder::write_gofs(Sample_Stream<SAMPLE_STREAM_TYPE::V3C>& gofs)
+  {
+    for (auto gof_it = gofs.begin(); gof_it != gofs.end(); ++gof_it)
+    {
+      const V3C_Gof& gof = *gof_it;
+      const auto vps = gof.find(V3C_VPS);
+      const bool is_timed = gof.is_timestamp_set();
+      const uint32_t timestamp = gofs.timestamp(gof);
+
+      if (!writer_) open_segment(timestamp, is_timed);
+      if (is_timed)
+      {
+        if (has_last_timestamp_ && timestamp != last_timestamp_) gof_duration_ = timestamp - last_timestamp_;
+        last_timestamp_ = timestamp;
+        has_last_timestamp_ = true;
+      }
+
+      // Each segment needs to be decodable on its own, so repeat the latest vps if the first gof does not carry one
+      if (vps != gof.end())
+      {
+        vps_.resize(vps->second.size());
+        vps->second.write_bitstream(&vps_[0]);
+      }
+      else if (writer_->num_gofs_written() == 0)
+      {
+        if (vps_.empty()) throw std::runtime_error("Cannot start a segment before a V3C parameter set has been received");
+        writer_->write_unit(vps_.data(), vps_.size());
+      }
+
+      writer_->write_gof(gofs, gof_it);
+
+      if (writer_->num_gofs_written() >= gofs_per_segment_) close_segment();
+    }
+  }
+
+  void Segment_Recorder::open_segment(const uint32_t first_timestamp, const bool is_timed)
+  {
+    size_t ind = 0;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      ind = segments_.size();
+      // Duration of the previous segment is exact once the next segment starts. The manifest picks it up when this segment is closed
+      if (is_timed && prev_segment_timed_ && !segments_.empty())
+      {
+        segments_.back().duration = static_cast<double>(first_timestamp - segments_.back().first_timestamp) / RTP_CLOCK_RATE;
+      }
+    }
+    cur_segment_ = Segment_Info{ segment_file_name(path_prefix_, ind), 0, first_timestamp, 0.0, 0 };
+    cur_segment_timed_ = is_timed;
+
+#ifdef _WIN32
+    fd_ = _open(cur_segment_.file_name.c_str(), _O_RDWR | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+    fd_ = open(cur_segment_.file_name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+#endif
+    if (fd_ < 0) throw std::runtime_error("Failed to open segment file " + cur_segment_.file_name + " (" + std::strerror(errno) + ")");
+
+    writer_ = std::make_unique<Sample_Stream_Writer>(fd_, size_precision_);
+  }
+
+  void Segment_Recorder::close_segment()
+  {
+    writer_->finish();
+    cur_segment_.num_gofs = writer_->num_gofs_written();
+    // Until the next segment starts, the last gof is assumed to last as long as the gap between the latest gofs
+    cur_segment_.duration = cur_segment_timed_ ?
+      static_cast<double>(static_cast<uint32_t>(last_timestamp_ - cur_segment_.first_timestamp) + gof_duration_) / RTP_CLOCK_RATE :
+      static_cast<double>(cur_segment_.num_gofs) / DEFAULT_FRAME_RATE;
+    prev_segment_timed_ = cur_segment_timed_;
+    cur_segment_.size = writer_->bytes_written();
+    writer_.reset();
+
+#ifdef _WIN32
+    const int ret = _close(fd_);
+#else
+    const int ret = close(fd_);
+#endif
+    fd_ = -1;
+    if (ret != 0) throw std::runtime_error("Failed to close segment file " + cur_segment_.file_name + " (" + std::strerror(errno) + ")");
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      segments_.push_back(cur_segment_);
+    }
+    write_manifest();
+  }
+
+  // Manifest is a text file with a "uvgV3CRTP-segments <version> <num segments>" line followed by one "<file> <num gofs> <first timestamp> <duration> <bytes>" line per segment.
+  // It is written to a temporary file and renamed so readers never see a partial manifest
+  void Segment_Recorder::write_manifest() const
+  {
+    const std::string manifest = path_prefix_ + ".manifest";
+    const std::string tmp = manifest + ".tmp";
+
+    const auto segments = this->segments();
+    {
+      std::ofstream out(tmp, std::ios::trunc);
+      out << "uvgV3CRTP-segments 1 " << segments.size() << '\n';
+      for (const auto& segment : segments)
+      {
+        out << segment.file_name << ' ' << segment.num_gofs << ' ' << segment.first_timestamp << ' ' << segment.duration << ' ' << segment.size << '\n';
+      }
+      if (!out.flush()) throw std::runtime_error("Failed to write segment manifest " + tmp);
+    }
+#ifdef _WIN32
+    std::remove(manifest.c_str());
+#endif
+    if (std::rename(tmp.c_str(), manifest.c_str()) != 0) throw std::runtime_error("Failed to rename segment manifest to " + manifest + " (" + std::strerror(errno) + ")");
+  }
+
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "uvgv3crtp/global.h"
+#include "Sample_Stream.h"
+#include "Sample_Stream_Writer.h"
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+namespace uvgV3CRTP {
+
+  struct Segment_Info
+  {
+    std::string file_name;
+    size_t num_gofs;
+    uint32_t first_timestamp;
+    double duration; // Seconds, from the gof timestamps if they are set
+    size_t size; // Bytes
+  };
+
+  // Records a sample stream as independently decodable segment files of a fixed number of gofs. Each segment has its own sample stream header
+  // and starts with the latest VPS. Files are written on a background thread and a manifest of the segments is rewritten whenever a segment is closed
+  class Segment_Recorder
+  {
+  public:
+    // Segments are named <path_prefix>NNNNNN.v3c and the manifest <path_prefix>.manifest. With size_precision (uint8_t)-1 it is inferred per segment.
+    // push() blocks while more than max_queued_gofs gofs wait to be written, 0 does not limit the queue
+    Segment_Recorder(const std::string& path_prefix, const size_t gofs_per_segment, const uint8_t size_precision = static_cast<uint8_t>(-1), const size_t max_queued_gofs = DEFAULT_MAX_QUEUED_GOFS);
+    ~Segment_Recorder();
+
+    Segment_Recorder(const Segment_Recorder&) = delete;
+    Segment_Recorder& operator=(const Segment_Recorder&) = delete;
+
+    void push(Sample_Stream<SAMPLE_STREAM_TYPE::V3C>&& gofs); // Queue gofs for writing. Blocks while the queue is full, otherwise returns immediately. Rethrows an earlier write error
+    void finish(); // Write queued gofs, close the last segment and write the manifest. Rethrows a write error
+
+    std::vector<Segment_Info> segments() const; // Closed segments
+
+  private:
+    void run();
+    void write_gofs(Sample_Stream<SAMPLE_STREAM_TYPE::V3C>& gofs);
+    void open_segment(const uint32_t first_timestamp, const bool is_timed);
+    void close_segment();
+    void write_manifest() const;
+
+    const std::string path_prefix_;
+    const size_t gofs_per_segment_;
+    const uint8_t size_precision_;
+    const size_t max_queued_gofs_;
+
+    // Only accessed by the writer thread
+    int fd_ = -1;
+    std::unique_ptr<Sample_Stream_Writer> writer_;
+    Segment_Info cur_segment_ = {};
+    std::string vps_; // Latest VPS unit, repeated at the start of each segment
+    bool cur_segment_timed_ = false; // Segment starts with a timed gof, so its duration comes from timestamps
+    bool prev_segment_timed_ = false;
+    bool has_last_timestamp_ = false;
+    uint32_t last_timestamp_ = 0; // Timestamp of the latest timed gof
+    uint32_t gof_duration_ = RTP_CLOCK_RATE / DEFAULT_FRAME_RATE; // Latest timestamp delta between gofs, used as the duration of the last gof of a segment
+
+    mutable std::mutex mutex_;
+    std::condition_variable cond_;
+    std::condition_variable space_cond_; // Signaled when queued gofs have been written
+    std::deque<Sample_Stream<SAMPLE_STREAM_TYPE::V3C>> queue_;
+    size_t num_queued_gofs_ = 0;
+    std::vector<Segment_Info> segments_;
+    std::exception_ptr error_;
+    bool stop_ = false;
+    bool finished_ = false;
+    std::thread thread_;
+  };
+
+}
@@ -0,0 +1,54 @@
+#include "Segment_Writer.h"
+
+#include <stdexcept>
+
+namespace uvgV3CRTP {
+
+  Segment_Writer::Segment_Writer(BitstreamSegment * const segments, char * const scratch) :
+    segments_(segments),
+    scratch_(scratch)
+  {
+  }
+
+  char* Segment_Writer::scratch(const size_t len)
+  {
+    if (!segments_)
+    {
+      // Counting pass, only track how much would be written
+      if (len > sizeof(discard_)) throw std::length_error("Scratch write exceeds maximum header length");
+      if (len > 0 && !in_scratch_) ++num_segments_;
+      if (len > 0) in_scratch_ = true;
+      scratch_len_ += len;
+      length_ += len;
+      return discard_;
+    }
+
+    char * const ptr = &scratch_[scratch_len_];
+    if (len == 0) return ptr;
+
+    if (!in_scratch_)
+    {
+      segments_[num_segments_++] = { ptr, 0 };
+      in_scratch_ = true;
+    }
+    segments_[num_segments_ - 1].len += len;
+    scratch_len_ += len;
+    length_ += len;
+
+    return ptr;
+  }
+
+  void Segment_Writer::reference(const char * const data, const size_t len)
+  {
+    if (len == 0) return;
+
+    if (segments_)
+    {
+      segments_[num_segments_] = { data, len };
+    }
+    ++num_segments_;
+    in_scratch_ = false;
+    length_ += len;
+  }
+
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "uvgv3crtp/global.h"
+
+#include <cstddef>
+#include <cstdlib>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+namespace uvgV3CRTP {
+
+  // Collects a serialized bitstream as segments. Headers and size fields go to scratch memory, payloads are referenced in place.
+  // Used in two passes: the counting pass (default constructor) only sizes the output, the second pass fills preallocated memory
+  class Segment_Writer
+  {
+  public:
+    Segment_Writer() = default;
+    Segment_Writer(BitstreamSegment * const segments, char * const scratch);
+    ~Segment_Writer() = default;
+
+    Segment_Writer(const Segment_Writer&) = delete;
+    Segment_Writer& operator=(const Segment_Writer&) = delete;
+
+    char* scratch(const size_t len); // Get len bytes of scratch memory to write headers or size fields to. Consecutive scratch is merged into one segment
+    void reference(const char * const data, const size_t len); // Add a segment pointing to existing data
+
+    size_t num_segments() const { return num_segments_; }
+    size_t scratch_len() const { return scratch_len_; }
+    size_t length() const { return length_; } // Total length of the serialized bitstream
+
+    // Run write with a counting writer first to size the output, then allocate segments and scratch as one block and run write again to fill it
+    template <typename WriteFunc>
+    static std::unique_ptr<BitstreamSegment, decltype(&free)> make_segments(WriteFunc&& write, size_t& num_segments)
+    {
+      Segment_Writer counter;
+      write(counter);
+
+      const size_t segments_len = counter.num_segments() * sizeof(BitstreamSegment);
+      std::unique_ptr<BitstreamSegment, decltype(&free)> block((BitstreamSegment *)malloc(segments_len + counter.scratch_len() + 1), &free);
+      if (!block) throw std::bad_alloc();
+
+      Segment_Writer writer(block.get(), &reinterpret_cast<char*>(block.get())[segments_len]);
+      write(writer);
+
+      if (writer.num_segments() != counter.num_segments() || writer.length() != counter.length()) throw std::logic_error(std::string("Error: size mismatch in ") + __func__ +
+        " at " + __FILE__ + ":" + std::to_string(__LINE__));
+
+      num_segments = writer.num_segments();
+      return block;
+    }
+
+  private:
+    BitstreamSegment * const segments_ = nullptr;
+    char * const scratch_ = nullptr;
+
+    size_t num_segments_ = 0;
+    size_t scratch_len_ = 0;
+    size_t length_ = 0;
+    bool in_scratch_ = false; // Last segment is scratch memory and can be extended
+
+    char discard_[2 * MAX_V3C_SIZE_PREC] = {}; // Write target for the counting pass
+  };
+
+}
@@ -25,4 +25,8 @@ namespace uvgV3CRTP {
       return timestamp_set_;
   }
 
+  Timestamp Timestamp::resolve(const Timestamp& parent) const {
+      return timestamp_set_ ? *this : parent;
+  }
+
 }
@@ -11,10 +11,14 @@ public:
     ~Timestamp() = default;
 
     uint32_t get_timestamp() const;
-    virtual void set_timestamp(uint32_t timestamp) const;
-    virtual void unset_timestamp() const;
+    void set_timestamp(uint32_t timestamp) const;
+    void unset_timestamp() const;
     bool is_timestamp_set() const;
 
+    // Units of a gof and nalus of a unit inherit the parent timestamp unless they have their own, so setting a parent timestamp does not touch its children.
+    // Returns the own timestamp if set, otherwise the parent's
+    Timestamp resolve(const Timestamp& parent) const;
+
 private:
     mutable uint32_t timestamp_ = 0;
     mutable bool timestamp_set_ = false;
@@ -0,0 +1,174 @@
+#pragma once
+
+#include "uvgv3crtp/global.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace uvgV3CRTP {
+
+  // Map keyed by V3C unit type that stores values in a fixed slot per type with a presence mask, so lookups do not walk a tree or allocate.
+  // Mirrors the std::map interface used in the library. Iteration visits present slots in ascending type order and yields std::pair<const V3C_UNIT_TYPE, T>
+  template <typename T>
+  class Unit_Map
+  {
+  public:
+    using key_type = V3C_UNIT_TYPE;
+    using mapped_type = T;
+    using value_type = std::pair<const V3C_UNIT_TYPE, T>;
+    using size_type = size_t;
+
+    template <bool IsConst>
+    class Iterator {
+    public:
+      using iterator_category = std::forward_iterator_tag;
+      using value_type = Unit_Map::value_type;
+      using difference_type = std::ptrdiff_t;
+      using pointer = std::conditional_t<IsConst, const value_type*, value_type*>;
+      using reference = std::conditional_t<IsConst, const value_type&, value_type&>;
+      using map_pointer = std::conditional_t<IsConst, const Unit_Map*, Unit_Map*>;
+
+      Iterator() = default;
+      Iterator(map_pointer map, size_t index) : map_(map), index_(index) {}
+      template <bool C = IsConst, typename = std::enable_if_t<!C>>
+      operator Iterator<true>() const { return Iterator<true>(map_, index_); }
+
+      reference operator*() const { return *map_->slot(index_); }
+      pointer operator->() const { return map_->slot(index_); }
+      Iterator& operator++() { index_ = map_->next(index_ + 1); return *this; }
+      Iterator operator++(int) { Iterator tmp = *this; ++(*this); return tmp; }
+      bool operator==(const Iterator& other) const { return index_ == other.index_ && map_ == other.map_; }
+      bool operator!=(const Iterator& other) const { return !(*this == other); }
+
+    private:
+      map_pointer map_ = nullptr;
+      size_t index_ = NUM_V3C_UNIT_TYPES;
+    };
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    Unit_Map() = default;
+    ~Unit_Map() { clear(); }
+
+    Unit_Map(const Unit_Map& other)
+    {
+      for (const auto& [type, value] : other) emplace(type, value);
+    }
+    Unit_Map& operator=(const Unit_Map& other)
+    {
+      if (this == &other) return *this;
+      clear();
+      for (const auto& [type, value] : other) emplace(type, value);
+      return *this;
+    }
+
+    Unit_Map(Unit_Map&& other) noexcept(std::is_nothrow_move_constructible_v<T>)
+    {
+      take(std::move(other));
+    }
+    Unit_Map& operator=(Unit_Map&& other) noexcept(std::is_nothrow_move_constructible_v<T>)
+    {
+      if (this == &other) return *this;
+      clear();
+      take(std::move(other));
+      return *this;
+    }
+
+    iterator begin() { return iterator(this, next(0)); }
+    iterator end() { return iterator(this, NUM_V3C_UNIT_TYPES); }
+    const_iterator begin() const { return const_iterator(this, next(0)); }
+    const_iterator end() const { return const_iterator(this, NUM_V3C_UNIT_TYPES); }
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend() const { return end(); }
+
+    size_t size() const
+    {
+      size_t num = 0;
+      for (uint8_t mask = mask_; mask; mask &= mask - 1) ++num;
+      return num;
+    }
+    bool empty() const { return mask_ == 0; }
+    uint8_t mask() const { return mask_; } // Bit n is set if type n is present
+
+    bool contains(const V3C_UNIT_TYPE type) const { return is_valid(type) && (mask_ & bit(type)); }
+    size_t count(const V3C_UNIT_TYPE type) const { return contains(type) ? 1 : 0; }
+
+    iterator find(const V3C_UNIT_TYPE type) { return contains(type) ? iterator(this, type) : end(); }
+    const_iterator find(const V3C_UNIT_TYPE type) const { return contains(type) ? const_iterator(this, type) : end(); }
+
+    T& at(const V3C_UNIT_TYPE type)
+    {
+      if (!contains(type)) throw std::out_of_range("No value for V3C unit type " + std::to_string(type));
+      return slot(type)->second;
+    }
+    const T& at(const V3C_UNIT_TYPE type) const
+    {
+      if (!contains(type)) throw std::out_of_range("No value for V3C unit type " + std::to_string(type));
+      return slot(type)->second;
+    }
+
+    T& operator[](const V3C_UNIT_TYPE type) { return emplace(type).first->second; }
+
+    // Like std::map::emplace, the value is not replaced if the type is already present
+    template <typename... Args>
+    std::pair<iterator, bool> emplace(const V3C_UNIT_TYPE type, Args&&... args)
+    {
+      if (!is_valid(type)) throw std::out_of_range("Invalid V3C unit type " + std::to_string(type));
+      if (mask_ & bit(type)) return { iterator(this, type), false };
+
+      ::new (static_cast<void*>(&storage_[type])) value_type(std::piecewise_construct, std::forward_as_tuple(type), std::forward_as_tuple(std::forward<Args>(args)...));
+      mask_ |= bit(type);
+      return { iterator(this, type), true };
+    }
+
+    size_t erase(const V3C_UNIT_TYPE type)
+    {
+      if (!contains(type)) return 0;
+      slot(type)->~value_type();
+      mask_ &= ~bit(type);
+      return 1;
+    }
+
+    void clear()
+    {
+      for (size_t i = next(0); i < NUM_V3C_UNIT_TYPES; i = next(i + 1)) slot(i)->~value_type();
+      mask_ = 0;
+    }
+
+  private:
+    static_assert(NUM_V3C_UNIT_TYPES <= 8, "Presence mask holds one bit per V3C unit type");
+
+    static bool is_valid(const V3C_UNIT_TYPE type) { return type >= 0 && type < NUM_V3C_UNIT_TYPES; }
+    static uint8_t bit(const size_t index) { return static_cast<uint8_t>(1u << index); }
+
+    value_type* slot(const size_t index) { return std::launder(reinterpret_cast<value_type*>(&storage_[index])); }
+    const value_type* slot(const size_t index) const { return std::launder(reinterpret_cast<const value_type*>(&storage_[index])); }
+
+    size_t next(size_t index) const // Index of the first present slot at or after index, NUM_V3C_UNIT_TYPES if none
+    {
+      while (index < NUM_V3C_UNIT_TYPES && !(mask_ & bit(index))) ++index;
+      return index;
+    }
+
+    void take(Unit_Map&& other)
+    {
+      for (size_t i = other.next(0); i < NUM_V3C_UNIT_TYPES; i = other.next(i + 1))
+      {
+        ::new (static_cast<void*>(&storage_[i])) value_type(static_cast<V3C_UNIT_TYPE>(i), std::move(other.slot(i)->second));
+      }
+      mask_ = other.mask_;
+      other.clear();
+    }
+
+    std::aligned_storage_t<sizeof(value_type), alignof(value_type)> storage_[NUM_V3C_UNIT_TYPES];
+    uint8_t mask_ = 0;
+  };
+
+}
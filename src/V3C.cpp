@@ -3,16 +3,36 @@
 #include "V3C_Gof.h"
 #include "V3C_Unit.h"
 #include "Sample_Stream.h"
+#include "Gof_Index.h"
 
 #include <type_traits>
 #include <sstream>
 #include <stdexcept>
 #include <limits>
+#include <algorithm>
+#include <optional>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <system_error>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 namespace uvgV3CRTP {
 
   // Explicitly define necessary instantiations so code is linked properly
   template void V3C::write_out_of_band_info<V3C::InfoDataType, Sample_Stream<SAMPLE_STREAM_TYPE::V3C>>(std::ostream&, Sample_Stream<SAMPLE_STREAM_TYPE::V3C> const&, const INFO_FMT, const INFO_FMT);
+  template void V3C::write_out_of_band_info<V3C::InfoDataType, V3C::InfoDataType>(std::ostream&, V3C::InfoDataType const&, const INFO_FMT, const INFO_FMT);
   template void V3C::write_out_of_band_info<V3C::InfoDataType, V3C_Gof>(std::ostream&, V3C_Gof const&, const INFO_FMT, const INFO_FMT);
   template void V3C::write_out_of_band_info<V3C::HeaderDataType, V3C_Gof>(std::ostream&, V3C_Gof const&, const INFO_FMT, const INFO_FMT);
   template void V3C::write_out_of_band_info<V3C::PayloadDataType, V3C_Gof>(std::ostream&, V3C_Gof const&, const INFO_FMT, const  INFO_FMT);
@@ -100,6 +120,14 @@ namespace uvgV3CRTP {
       using type = std::string;
     };
   }
+  bool V3C::is_filtered_unit(const char * const unit, const size_t size, const INIT_FLAGS unit_filter)
+  {
+    if (unit_filter == INIT_FLAGS::ALL || size == 0) return false;
+    const uint8_t vuh_unit_type = static_cast<uint8_t>(unit[0]) >> 3;
+    if (vuh_unit_type >= NUM_V3C_UNIT_TYPES) return false; // Let unit parsing report invalid types
+    return !is_set(unit_filter, static_cast<INIT_FLAGS>(1 << vuh_unit_type));
+  }
+
   template <auto Field>
   using FieldDataType = _FieldDataType<decltype(Field), Field>;
 
@@ -228,8 +256,10 @@ namespace uvgV3CRTP {
     return flags;
   }
 
-  Sample_Stream<SAMPLE_STREAM_TYPE::V3C> V3C::parse_bitstream(const char * const bitstream, const size_t len)
+  Sample_Stream<SAMPLE_STREAM_TYPE::V3C> V3C::parse_bitstream(const char * const bitstream, const size_t len, const PARSE_FLAGS flags, size_t num_threads, const INIT_FLAGS unit_filter)
   {
+    if (num_threads == 0) num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+
     // First byte should be the v3c sample stream header
     uint8_t v3c_size_precision = parse_size_precision(bitstream);
     if (!(0 < v3c_size_precision && v3c_size_precision <= 8))
@@ -241,6 +271,12 @@ namespace uvgV3CRTP {
     }
 
     Sample_Stream<SAMPLE_STREAM_TYPE::V3C> sample_stream(v3c_size_precision);
+
+    if (num_threads > 1)
+    {
+      parse_units_parallel(bitstream, len, v3c_size_precision, flags, num_threads, unit_filter, sample_stream);
+      return sample_stream;
+    }
     
     // Start processing v3c units
     for (size_t ptr = SAMPLE_STREAM_HDR_LEN; ptr < len;) {
@@ -249,10 +285,16 @@ namespace uvgV3CRTP {
       size_t v3c_size = parse_sample_stream_size(&bitstream[ptr], v3c_size_precision);
       ptr += v3c_size_precision; // Jump over the V3C unit size bytes
 
+      if (is_filtered_unit(&bitstream[ptr], v3c_size, unit_filter))
+      {
+        ptr += v3c_size;
+        continue;
+      }
+
       try
       {
         // Inside v3c unit now
-        V3C_Unit new_unit(&bitstream[ptr], v3c_size);
+        V3C_Unit new_unit(&bitstream[ptr], v3c_size, flags);
         ptr += v3c_size;
 
         sample_stream.push_back(std::move(new_unit));
@@ -270,6 +312,160 @@ namespace uvgV3CRTP {
     return sample_stream;
   }
 
+  void V3C::parse_units_parallel(const char * const bitstream, const size_t len, const uint8_t v3c_size_precision, const PARSE_FLAGS flags, const size_t num_threads, const INIT_FLAGS unit_filter, Sample_Stream<SAMPLE_STREAM_TYPE::V3C>& sample_stream)
+  {
+    // Index v3c unit boundaries first. Only the size fields need to be read so this is cheap compared to parsing the units
+    std::vector<std::pair<size_t, size_t>> unit_spans; // (offset, size)
+    for (size_t ptr = SAMPLE_STREAM_HDR_LEN; ptr < len;) {
+      if (len - ptr < v3c_size_precision)
+      {
+        throw ParseException(
+          std::string("Error parsing bitstream in ") + __func__ +
+          " at " + __FILE__ + ":" + std::to_string(__LINE__) + " with error: truncated V3C unit size field"
+        );
+      }
+      const size_t v3c_size = parse_sample_stream_size(&bitstream[ptr], v3c_size_precision);
+      ptr += v3c_size_precision; // Jump over the V3C unit size bytes
+      if (len - ptr < v3c_size)
+      {
+        throw ParseException(
+          std::string("Error parsing bitstream in ") + __func__ +
+          " at " + __FILE__ + ":" + std::to_string(__LINE__) + " with error: V3C unit size exceeds bitstream length"
+        );
+      }
+      if (!is_filtered_unit(&bitstream[ptr], v3c_size, unit_filter))
+      {
+        unit_spans.emplace_back(ptr, v3c_size);
+      }
+      ptr += v3c_size;
+    }
+
+    // Construct units concurrently. Each worker grabs the next unparsed unit so large video units do not stall the others
+    std::vector<std::optional<V3C_Unit>> units(unit_spans.size());
+    std::atomic<size_t> next_unit{ 0 };
+    std::mutex error_mutex;
+    std::string error_msg;
+
+    const auto worker = [&]() {
+      try
+      {
+        for (size_t i = next_unit++; i < unit_spans.size(); i = next_unit++)
+        {
+          units[i].emplace(&bitstream[unit_spans[i].first], unit_spans[i].second, flags);
+        }
+      }
+      catch (const std::exception& e)
+      {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (error_msg.empty()) error_msg = e.what();
+        next_unit = unit_spans.size(); // Stop other workers
+      }
+    };
+
+    std::vector<std::thread> workers;
+    const size_t num_workers = std::min(num_threads, unit_spans.size());
+    workers.reserve(num_workers); // Only thread creation can throw below, so started threads are always joined
+    for (size_t i = 1; i < num_workers; ++i)
+    {
+      try
+      {
+        workers.emplace_back(worker);
+      }
+      catch (const std::system_error&)
+      {
+        break; // Out of threads, the already running workers share the remaining units
+      }
+    }
+    worker(); // Calling thread works as well
+    for (auto& thread : workers)
+    {
+      thread.join();
+    }
+
+    if (!error_msg.empty())
+    {
+      throw ParseException(
+        std::string("Error parsing bitstream in ") + __func__ +
+        " at " + __FILE__ + ":" + std::to_string(__LINE__) + " with error: " + error_msg
+      );
+    }
+
+    // Merge in bitstream order so gof assignment matches the serial parse
+    for (auto& unit : units)
+    {
+      sample_stream.push_back(std::move(*unit));
+    }
+  }
+
+  Sample_Stream<SAMPLE_STREAM_TYPE::V3C> V3C::parse_bitstream(std::shared_ptr<const char[]> bitstream, const size_t len, const size_t num_threads, const INIT_FLAGS unit_filter)
+  {
+    Sample_Stream<SAMPLE_STREAM_TYPE::V3C> sample_stream = parse_bitstream(bitstream.get(), len, PARSE_FLAGS::BORROW, num_threads, unit_filter);
+    sample_stream.add_backing_buffer(std::move(bitstream));
+
+    return sample_stream;
+  }
+
+  Sample_Stream<SAMPLE_STREAM_TYPE::V3C> V3C::parse_file(const char * const path, const size_t num_threads, const INIT_FLAGS unit_filter)
+  {
+    size_t len = 0;
+    std::shared_ptr<const char[]> mapping = map_file(path, len);
+    return parse_bitstream(std::move(mapping), len, num_threads, unit_filter);
+  }
+
+  std::shared_ptr<const char[]> V3C::map_file(const char * const path, size_t& len)
+  {
+    const auto error = [path](const std::string& msg) {
+      return ParseException(
+        std::string("Error mapping file ") + path + " with error: " + msg
+      );
+    };
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) throw error("failed to open file");
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+    {
+      CloseHandle(file);
+      throw error("failed to get file size or file is empty");
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file); // Mapping object keeps the file open
+    if (mapping == NULL) throw error("failed to create file mapping");
+
+    const char* view = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    CloseHandle(mapping); // View keeps the mapping alive
+    if (view == NULL) throw error("failed to map view of file");
+
+    len = static_cast<size_t>(size.QuadPart);
+    return std::shared_ptr<const char[]>(view, [](const char* ptr) { UnmapViewOfFile(ptr); });
+#else
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) throw error("failed to open file");
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+      close(fd);
+      throw error("failed to get file size or file is empty");
+    }
+    const size_t size = static_cast<size_t>(st.st_size);
+
+    void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // Mapping keeps a reference to the file
+    if (view == MAP_FAILED) throw error("failed to mmap file");
+
+    // Input is parsed front to back and then sent in order
+    madvise(view, size, MADV_SEQUENTIAL);
+    madvise(view, size, MADV_WILLNEED);
+
+    len = size;
+    return std::shared_ptr<const char[]>(static_cast<const char*>(view), [size](const char* ptr) { munmap(const_cast<char*>(ptr), size); });
+#endif
+  }
+
   template<SAMPLE_STREAM_TYPE E>
   size_t V3C::sample_stream_header_size(V3C_UNIT_TYPE type)
   {
@@ -295,6 +491,53 @@ namespace uvgV3CRTP {
     return SAMPLE_STREAM_HDR_LEN;
   }
 
+  uint8_t V3C::min_size_precision(const size_t size)
+  {
+    if (size < (1LLU << (1 * SIZE_PREC_MULT))) return 1; // 1 is the smallest allowed precision and number of size bits is prec * SIZE_PREC_MULT
+    
+    // Precision should be in range [1, 8] so start checking from 4
+    if (size < (1LLU << (4 * SIZE_PREC_MULT)))
+    {
+      if (size < (1LLU << (3 * SIZE_PREC_MULT)))
+      {
+        if (size < (1LLU << (2 * SIZE_PREC_MULT)))
+        {
+          return 2;
+        } 
+        else //(1 << 2 * SIZE_PREC_MULT)) <= size < (1 << 3 * SIZE_PREC_MULT)) 
+        {
+          return 3;
+        }
+      }
+      else //(1 << 3 * SIZE_PREC_MULT)) <= size < (1 << 4 * SIZE_PREC_MULT)) 
+      {
+        return 4;
+      }
+    } else // (size >= (1 << 4 * SIZE_PREC_MULT))
+    {
+      if (size < (1LLU << (6 * SIZE_PREC_MULT)))
+      {
+        if (size < (1LLU << (5 * SIZE_PREC_MULT)))
+        {
+          return 5;
+        } 
+        else //(1 << 5 * SIZE_PREC_MULT)) <= size < (1 << 6 * SIZE_PREC_MULT)) 
+        {
+          return 6;
+        }
+      } 
+      else if /*(1 << 6 * SIZE_PREC_MULT) <=*/ (size < (1LLU << (7 * SIZE_PREC_MULT)))
+      {
+        return 7;
+      }
+    }
+
+    // Would overflow size_t anyway
+    //if (size >= (1LLU << (8 * SIZE_PREC_MULT))) throw std::runtime_error("Size exceeds maximum size precision range");
+
+    return 8;
+  }
+
   size_t V3C::parse_sample_stream_size(const char * const bitstream, const uint8_t precision)
   {
     if (precision > MAX_V3C_SIZE_PREC || precision <= 0)
@@ -1220,7 +1463,7 @@ namespace uvgV3CRTP {
       if constexpr (F == INFO_FMT::RAW)
       {
         get_field<PAYLOAD_FIELDS::PAYLOAD>(data.at(type)).append(
-          reinterpret_cast<char*>(nal.get().bitstream()), nal.get().size()
+          reinterpret_cast<const char*>(nal.bitstream()), nal.size()
         );
       }
       else if constexpr (F == INFO_FMT::BASE64)
@@ -1232,7 +1475,7 @@ namespace uvgV3CRTP {
           first_nal = false;
         }
         get_field<PAYLOAD_FIELDS::PAYLOAD>(data.at(type)).append(
-          enc_base64(reinterpret_cast<char*>(nal.get().bitstream()), nal.get().size())
+          enc_base64(reinterpret_cast<const char*>(nal.bitstream()), nal.size())
         );
       }
     }
@@ -1291,6 +1534,13 @@ namespace uvgV3CRTP {
     }
   }
 
+  template <INFO_FMT F = INFO_FMT::LOGGING>
+  static void populate_data(const V3C::InfoDataType& v3c_data, V3C::InfoDataType& data)
+  {
+    // Info has already been gathered e.g. by V3C::scan_bitstream_info
+    data = v3c_data;
+  }
+
   template<typename DataType = V3C::InfoDataType, typename Stream, typename DataClass>
   static auto _out_of_band_info(Stream& stream, const DataClass& v3c_data, const INFO_FMT field_fmt, const INFO_FMT value_fmt)
   {
@@ -1631,4 +1881,119 @@ namespace uvgV3CRTP {
       out_header[type]->vuh_auxiliary_video_flag = tmp_header.vuh_auxiliary_video_flag;
     }
   }
+
+  V3C::InfoDataType V3C::scan_bitstream_info(const char * const bitstream, const size_t len, std::vector<std::array<HeaderStruct, NUM_V3C_UNIT_TYPES>>* gof_headers, size_t* num_gofs)
+  {
+    // Locate v3c units from the sample stream size fields
+    const Gof_Index index = Gof_Index::build(bitstream, len);
+    if (index.num_gofs() == 0)
+    {
+      throw ParseException(
+        std::string("Error scanning bitstream in ") + __func__ +
+        " at " + __FILE__ + ":" + std::to_string(__LINE__) + " with error: bitstream has no V3C units"
+      );
+    }
+    if (num_gofs) *num_gofs = index.num_gofs();
+
+    InfoDataType info = {};
+    InfoDataType gof_info = {};
+    if (gof_headers) gof_headers->assign(index.num_gofs(), {});
+
+    for (size_t gof = 0; gof < index.num_gofs(); ++gof)
+    {
+      const Gof_Index_Entry& entry = index.at(gof);
+      for (size_t i = 0; i < NUM_V3C_UNIT_TYPES; ++i)
+      {
+        const V3C_UNIT_TYPE type = static_cast<V3C_UNIT_TYPE>(i);
+        if (entry.unit_sizes[type] == 0)
+        {
+          if (gof_headers) (*gof_headers)[gof][type].vuh_unit_type = static_cast<uint8_t>(V3C_UNDEF);
+          continue;
+        }
+        const char * const unit = &bitstream[entry.unit_offsets[type]];
+        const size_t unit_size = entry.unit_sizes[type];
+
+        const V3C_Unit::V3C_Unit_Header header(unit);
+        if (gof_headers)
+        {
+          HeaderStruct& out_header = (*gof_headers)[gof][type];
+          out_header.vuh_unit_type = header.vuh_unit_type;
+          out_header.vuh_v3c_parameter_set_id = header.vuh_v3c_parameter_set_id;
+          out_header.vuh_atlas_id = header.vuh_atlas_id;
+          out_header.vuh_attribute_index = header.vuh_attribute_index;
+          out_header.vuh_attribute_partition_index = header.vuh_attribute_partition_index;
+          out_header.vuh_map_index = header.vuh_map_index;
+          out_header.vuh_auxiliary_video_flag = header.vuh_auxiliary_video_flag;
+        }
+
+        auto& unit_info = gof_info[type];
+        if (type == V3C_VPS)
+        {
+          get_field<INFO_FIELDS::NUM>(unit_info) += 1;
+          continue;
+        }
+
+        // Count nal units by jumping over the nal size fields
+        const size_t nal_hdr_size = sample_stream_header_size<SAMPLE_STREAM_TYPE::NAL>(type);
+        const uint8_t nal_size_precision = nal_hdr_size > 0 ? parse_size_precision(&unit[header.size()]) : DEFAULT_VIDEO_NAL_SIZE_PRECISION;
+        size_t num_nalus = 0;
+        size_t ptr = header.size() + nal_hdr_size;
+        while (ptr < unit_size)
+        {
+          if (unit_size - ptr < nal_size_precision)
+          {
+            throw ParseException(
+              std::string("Error scanning bitstream in ") + __func__ +
+              " at " + __FILE__ + ":" + std::to_string(__LINE__) + " with error: truncated NAL unit size field"
+            );
+          }
+          ptr += nal_size_precision + parse_sample_stream_size(&unit[ptr], nal_size_precision);
+          ++num_nalus;
+        }
+        if (ptr != unit_size)
+        {
+          throw ParseException(
+            std::string("Error scanning bitstream in ") + __func__ +
+            " at " + __FILE__ + ":" + std::to_string(__LINE__) + " with error: NAL unit size exceeds V3C unit size"
+          );
+        }
+        get_field<INFO_FIELDS::NUM>(unit_info) = num_nalus;
+        get_field<INFO_FIELDS::SIZE_PREC>(unit_info) = nal_size_precision;
+      }
+
+      // Merge gof info the same way as when gathering info from a parsed sample stream
+      if (gof == 0)
+      {
+        info = std::move(gof_info);
+
+        // Use NUM_V3C_UNIT_TYPES to store global parameters
+        info[NUM_V3C_UNIT_TYPES] = {};
+        get_field<INFO_FIELDS::NUM>(info.at(NUM_V3C_UNIT_TYPES)) = 1;
+        get_field<INFO_FIELDS::SIZE_PREC>(info.at(NUM_V3C_UNIT_TYPES)) = index.size_precision();
+        get_field<INFO_FIELDS::VAR_NAL_PREC>(info.at(NUM_V3C_UNIT_TYPES)) = false;
+        get_field<INFO_FIELDS::VAR_NAL_NUM>(info.at(NUM_V3C_UNIT_TYPES)) = false;
+      }
+      else
+      {
+        get_field<INFO_FIELDS::NUM>(info.at(NUM_V3C_UNIT_TYPES)) += 1; // Count number of GOFs
+        for (const auto& [type, value] : gof_info)
+        {
+          if (type == V3C_VPS)
+          {
+            get_field<INFO_FIELDS::NUM>(info[V3C_VPS]) += get_field<INFO_FIELDS::NUM>(value);
+          }
+          else
+          {
+            get_field<INFO_FIELDS::VAR_NAL_PREC>(info.at(NUM_V3C_UNIT_TYPES)) |=
+              get_field<INFO_FIELDS::SIZE_PREC>(value) != get_field<INFO_FIELDS::SIZE_PREC>(info[type]);
+            get_field<INFO_FIELDS::VAR_NAL_NUM>(info.at(NUM_V3C_UNIT_TYPES)) |=
+              get_field<INFO_FIELDS::NUM>(value) != get_field<INFO_FIELDS::NUM>(info[type]);
+          }
+        }
+      }
+      gof_info.clear();
+    }
+
+    return info;
+  }
 }
\ No newline at end of file
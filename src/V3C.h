@@ -10,9 +10,11 @@
 #include <map>
 #include <exception>
 #include <array>
+#include <memory>
 
 #include "uvgv3crtp/global.h"
 #include "Sample_Stream.h"
+#include "V3C_Gof.h"
 
 namespace uvgV3CRTP {
 
@@ -40,10 +42,17 @@ namespace uvgV3CRTP {
     static std::vector<V3C_UNIT_TYPE> unit_types_from_init_flag(const INIT_FLAGS flags);
     static INIT_FLAGS init_flags_from_unit_types(const std::vector<V3C_UNIT_TYPE>& unit_types);
     
-    static Sample_Stream<SAMPLE_STREAM_TYPE::V3C> parse_bitstream(const char * const bitstream, const size_t len);
+    // num_threads > 1 parses V3C units concurrently, 0 uses all hardware threads
+    static Sample_Stream<SAMPLE_STREAM_TYPE::V3C> parse_bitstream(const char * const bitstream, const size_t len, const PARSE_FLAGS flags = PARSE_FLAGS::NUL, size_t num_threads = 1, const INIT_FLAGS unit_filter = INIT_FLAGS::ALL); // Unit types not in unit_filter are skipped without parsing
+    static Sample_Stream<SAMPLE_STREAM_TYPE::V3C> parse_bitstream(std::shared_ptr<const char[]> bitstream, const size_t len, const size_t num_threads = 1, const INIT_FLAGS unit_filter = INIT_FLAGS::ALL); // Always borrows, returned stream keeps bitstream alive
+    static Sample_Stream<SAMPLE_STREAM_TYPE::V3C> parse_file(const char * const path, const size_t num_threads = 1, const INIT_FLAGS unit_filter = INIT_FLAGS::ALL); // Parse directly from a read-only file mapping
+    static std::shared_ptr<const char[]> map_file(const char * const path, size_t& len); // Mapping is released when the last reference is dropped
+
+    static bool is_filtered_unit(const char * const unit, const size_t size, const INIT_FLAGS unit_filter); // Check unit type from the first header byte so filtered units can be skipped without parsing them
 
     static uint8_t parse_size_precision(const char * const bitstream);
     static size_t write_size_precision(char * const bitstream, const uint8_t precision);
+    static uint8_t min_size_precision(const size_t size); // Smallest precision whose size field fits size
     static size_t parse_sample_stream_size(const char * const bitstream, const uint8_t precision);
     static size_t write_sample_stream_size(char * const bitstream, const size_t size, const uint8_t precision);
 
@@ -62,6 +71,7 @@ namespace uvgV3CRTP {
     static void write_out_of_band_info(std::ostream& out_stream, const DataClass& data, const INFO_FMT field_fmt = INFO_FMT::LOGGING, const INFO_FMT value_fmt = INFO_FMT::LOGGING);
     template <typename DataType, typename DataClass>
     static DataType read_out_of_band_info(std::istream& in_stream, const INFO_FMT field_fmt = INFO_FMT::LOGGING, const INFO_FMT value_fmt = INFO_FMT::LOGGING, const INIT_FLAGS init_flags = INIT_FLAGS::NUL);
+    static InfoDataType scan_bitstream_info(const char * const bitstream, const size_t len, std::vector<std::array<HeaderStruct, NUM_V3C_UNIT_TYPES>>* gof_headers = nullptr, size_t* num_gofs = nullptr); // Only reads size fields and headers, nothing is copied
     static void populate_bitstream_info(const InfoDataType& in_info, BitstreamInfo& out_info);
     static void populate_header(const HeaderDataType& in_header, HeaderStruct* out_header[NUM_V3C_UNIT_TYPES]);
     static void populate_header(const PayloadDataType& in_header, HeaderStruct* out_header[NUM_V3C_UNIT_TYPES]);
@@ -71,6 +81,8 @@ namespace uvgV3CRTP {
 
   protected:
     uvgrtp::media_stream* get_stream(const V3C_UNIT_TYPE type) const;
+
+    static void parse_units_parallel(const char * const bitstream, const size_t len, const uint8_t v3c_size_precision, const PARSE_FLAGS flags, const size_t num_threads, const INIT_FLAGS unit_filter, Sample_Stream<SAMPLE_STREAM_TYPE::V3C>& sample_stream);
       
     static RTP_FLAGS get_flags(const V3C_UNIT_TYPE type);
     static RTP_FORMAT get_format(const V3C_UNIT_TYPE type);
@@ -130,6 +142,7 @@ namespace uvgV3CRTP {
 
   // Explicitly define necessary instantiations so code is linked properly
   extern template void V3C::write_out_of_band_info<V3C::InfoDataType, Sample_Stream<SAMPLE_STREAM_TYPE::V3C>>(std::ostream&, Sample_Stream<SAMPLE_STREAM_TYPE::V3C> const&, const INFO_FMT, const INFO_FMT);
+  extern template void V3C::write_out_of_band_info<V3C::InfoDataType, V3C::InfoDataType>(std::ostream&, V3C::InfoDataType const&, const INFO_FMT, const INFO_FMT);
   extern template void V3C::write_out_of_band_info<V3C::InfoDataType, V3C_Gof>(std::ostream&, V3C_Gof const&, const INFO_FMT, const INFO_FMT);
   extern template void V3C::write_out_of_band_info<V3C::HeaderDataType, V3C_Gof>(std::ostream&, V3C_Gof const&, const INFO_FMT, const  INFO_FMT);
   extern template void V3C::write_out_of_band_info<V3C::PayloadDataType, V3C_Gof>(std::ostream&, V3C_Gof const&, const INFO_FMT, const  INFO_FMT);
@@ -19,21 +19,17 @@ namespace uvgV3CRTP {
 
   void V3C_Gof::set(V3C_Unit&& unit)
   {
-    if (units_.empty() && !is_timestamp_set() && unit.is_timestamp_set())
+    if (!is_timestamp_set() && unit.is_timestamp_set())
     {
-      // If timestamp is not set and this is the first v3c unit, set the gof timestamp to the v3c units timestamp
+      // If timestamp is not set, set the gof timestamp to the v3c units timestamp
       set_timestamp(unit.get_timestamp());
     }
-    else if (is_timestamp_set() && !unit.is_timestamp_set())
-    {
-      // If gof timestamp is set and v3c unit timestamp is not set, set the v3c unit timestamp to the gof timestamp
-      unit.set_timestamp(get_timestamp());
-    }
     // Check that the v3c unit timestamp matches gof timestamp, if not this v3c unit does not belong to this gof
-    else if (is_timestamp_set() && unit.get_timestamp() != get_timestamp())
+    else if (is_timestamp_set() && unit.is_timestamp_set() && unit.get_timestamp() != get_timestamp())
     {
       throw TimestampException("Nalu timestamp does not match V3C unit timestamp");
     }
+    unit.unset_timestamp(); // The unit inherits the gof timestamp from now on
     const auto type = unit.type();
     units_.emplace(type, std::move(unit));
   }
@@ -48,24 +44,4 @@ namespace uvgV3CRTP {
     return size;
   }
 
-  void V3C_Gof::set_timestamp(const uint32_t timestamp) const
-  {
-    Timestamp::set_timestamp(timestamp);
-    // Also set the timestamp for all units in the GOF
-    for (const auto&[type, unit] : units_)
-    {
-      unit.set_timestamp(timestamp);
-    }
-  }
-
-  void V3C_Gof::unset_timestamp() const
-  {
-    Timestamp::unset_timestamp();
-    // Also unset the timestamp for all units in the GOF
-    for (const auto&[type, unit] : units_)
-    {
-      unit.unset_timestamp();
-    }
-  }
-
 }
\ No newline at end of file
@@ -1,18 +1,14 @@
 #pragma once
 
-#include <map>
-
 #include "uvgv3crtp/global.h"
 #include "Timestamp.h"
-//#include "V3C_Unit.h"
+#include "V3C_Unit.h"
+#include "Unit_Map.h"
 
 #include <cstddef>
 
 namespace uvgV3CRTP {
 
-  // Forward declare
-  class V3C_Unit;
-
   class V3C_Gof: public Timestamp
   {
   public:
@@ -58,13 +54,12 @@ namespace uvgV3CRTP {
     auto find(const V3C_UNIT_TYPE& type) const { return units_.find(type); }
 
     size_t size() const;
+    uint8_t unit_mask() const { return units_.mask(); } // Bit n is set if a unit of type n is present
 
-    void set_timestamp(const uint32_t timestamp) const override; // Set the timestamp for the gof and all its units. Gof timestamp should match v3c unit timestamps
-    void unset_timestamp() const override; // Unset the timestamp for the gof and all its units
   
   private:
 
-    std::map<V3C_UNIT_TYPE, V3C_Unit> units_;
+    Unit_Map<V3C_Unit> units_; // Units stored in place by type
   };
 
 }
\ No newline at end of file
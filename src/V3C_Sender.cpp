@@ -30,17 +30,29 @@ namespace uvgV3CRTP {
 
   void V3C_Sender::send_bitstream(const Sample_Stream<SAMPLE_STREAM_TYPE::V3C>& bitstream, const uint32_t rate_limit) const
   {
+    send_bitstream(bitstream, rate_limit, INIT_FLAGS::ALL);
+  }
+
+  void V3C_Sender::send_bitstream(const Sample_Stream_View& bitstream, const uint32_t rate_limit) const
+  {
+    send_bitstream(bitstream.stream(), rate_limit, bitstream.unit_filter());
+  }
+
+  void V3C_Sender::send_bitstream(const Sample_Stream<SAMPLE_STREAM_TYPE::V3C>& bitstream, const uint32_t rate_limit, const INIT_FLAGS unit_filter) const
+  {
+    const uint32_t offset = bitstream.timestamp_offset();
     auto timestamp = initial_timestamp_.get_timestamp();
-    for (const auto& gof : bitstream) {
+    for (auto it = bitstream.begin(); it != bitstream.end(); ++it) {
+      const V3C_Gof& gof = *it;
       // If initial timestamp has been set and gof timestamp is not set, use custom timestamp for gofs
       if (initial_timestamp_.is_timestamp_set() && !gof.is_timestamp_set()) {
-        gof.set_timestamp(timestamp);
+        bitstream.set_timestamp(it, timestamp);
         timestamp = calc_new_timestamp(timestamp, DEFAULT_FRAME_RATE, RTP_CLOCK_RATE);
       }
       else if (gof.is_timestamp_set()) { // else advance timestamp based on gof timestamp
-        timestamp = calc_new_timestamp(gof.get_timestamp(), DEFAULT_FRAME_RATE, RTP_CLOCK_RATE);
+        timestamp = calc_new_timestamp(bitstream.timestamp(gof), DEFAULT_FRAME_RATE, RTP_CLOCK_RATE);
       }
-      send_gof(gof);
+      send_gof(gof, unit_filter, offset);
 
       if (rate_limit > 0) {
         // Limit rate if requested
@@ -49,31 +61,36 @@ namespace uvgV3CRTP {
     }
   }
 
-  void V3C_Sender::send_gof(const V3C_Gof& gof) const
+  void V3C_Sender::send_gof(const V3C_Gof& gof, const INIT_FLAGS unit_filter, const uint32_t timestamp_offset) const
   {
     for (const auto& [type, v3c_unit] : gof) {
-      if (streams_.find(type) != streams_.end()) // Only send units for which stream has been initialized
+      // Only send units for which stream has been initialized and that are not filtered out
+      if (streams_.find(type) != streams_.end() && is_set(unit_filter, static_cast<INIT_FLAGS>(1 << type)))
       {
-        send_v3c_unit(v3c_unit);
+        send_v3c_unit(v3c_unit, gof, timestamp_offset);
       }
     }
   }
 
-  void V3C_Sender::send_v3c_unit(const V3C_Unit& unit) const
+  void V3C_Sender::send_v3c_unit(const V3C_Unit& unit, const Timestamp& parent, const uint32_t timestamp_offset) const
   {
     if (streams_.find(unit.type()) == streams_.end())
     {
       throw ConnectionException("Sender not initialized for V3C unit type " + std::to_string(static_cast<int>(unit.type())) + ")");
     }
 
+    const Timestamp unit_timestamp = unit.resolve(parent);
     for (const auto& nalu : unit.nalus()) {
+      const Timestamp nalu_timestamp = nalu.resolve(unit_timestamp);
+      // uvgRTP takes a non-const pointer but only reads the frame
+      uint8_t* const frame = const_cast<uint8_t*>(nalu.bitstream());
       rtp_error_t ret = RTP_OK;
-      if (!nalu.get().is_timestamp_set()) {
-        ret = this->get_stream(unit.type())->push_frame(nalu.get().bitstream(), nalu.get().size(), this->get_flags(unit.type()));
+      if (!nalu_timestamp.is_timestamp_set()) {
+        ret = this->get_stream(unit.type())->push_frame(frame, nalu.size(), this->get_flags(unit.type()));
       }
       else
       {
-        ret = this->get_stream(unit.type())->push_frame(nalu.get().bitstream(), nalu.get().size(), nalu.get().get_timestamp(), this->get_flags(unit.type()));
+        ret = this->get_stream(unit.type())->push_frame(frame, nalu.size(), nalu_timestamp.get_timestamp() + timestamp_offset, this->get_flags(unit.type()));
       }
       if (ret != RTP_OK) {
         throw std::runtime_error("Failed to send RTP frame");
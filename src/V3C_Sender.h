@@ -4,6 +4,7 @@
 #include "V3C_Gof.h"
 #include "V3C_Unit.h"
 #include "Sample_Stream.h"
+#include "Sample_Stream_View.h"
 
 #include <iostream>
 #include <fstream>
@@ -23,14 +24,17 @@ namespace uvgV3CRTP {
     ~V3C_Sender() = default;
 
     void send_bitstream(const Sample_Stream<SAMPLE_STREAM_TYPE::V3C>& bitstream, const uint32_t rate_limit = 0) const;
-    void send_gof(const V3C_Gof& gof) const;
-    void send_v3c_unit(const V3C_Unit& unit) const;
+    void send_bitstream(const Sample_Stream_View& bitstream, const uint32_t rate_limit = 0) const; // Only send the units selected by the view
+    // timestamp_offset is the offset of the sample stream the gof or unit belongs to and is added to the nalu timestamps
+    void send_gof(const V3C_Gof& gof, const INIT_FLAGS unit_filter = INIT_FLAGS::ALL, const uint32_t timestamp_offset = 0) const;
+    void send_v3c_unit(const V3C_Unit& unit, const Timestamp& parent = Timestamp(), const uint32_t timestamp_offset = 0) const; // parent is the gof of the unit, whose timestamp the unit inherits unless it has its own
 
     uint32_t get_initial_timestamp() const;
     void set_initial_timestamp(const uint32_t timestamp);
     bool is_initial_timestamp_set() const;
 
   private:
+    void send_bitstream(const Sample_Stream<SAMPLE_STREAM_TYPE::V3C>& bitstream, const uint32_t rate_limit, const INIT_FLAGS unit_filter) const;
 
     Timestamp initial_timestamp_; // Initial timestamp for the first frame sent
   };
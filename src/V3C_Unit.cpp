@@ -4,6 +4,9 @@
 
 #include <cassert>
 #include <stdexcept>
+#include <cstring>
+#include <array>
+#include <type_traits>
 
 namespace uvgV3CRTP {
 
@@ -17,7 +20,7 @@ namespace uvgV3CRTP {
   //  generic_payload_ = std::make_unique<char[]>(generic_payload_size_);
   //}
 
-  V3C_Unit::V3C_Unit(const char * const bitstream, const size_t len) :
+  V3C_Unit::V3C_Unit(const char * const bitstream, const size_t len, const PARSE_FLAGS flags) :
     Timestamp(),
     header_(bitstream),
     payload_(parse_precision(&bitstream[header_.size()]), get_sample_stream_header_size())
@@ -29,21 +32,53 @@ namespace uvgV3CRTP {
     }
     else
     {
-      const uint8_t nal_size_precision = payload_.size_precision();
-      const size_t sample_stream_hdr_offset = payload_.header_size;
+      // Keep the payload as a single block. Nalus are carved out of it instead of each getting their own allocation
+      raw_payload_len_ = len - header_.size();
+      if (is_set(flags, PARSE_FLAGS::BORROW))
+      {
+        raw_payload_ = &bitstream[header_.size()];
+      }
+      else
+      {
+        payload_buffer_ = std::unique_ptr<char[]>(new char[raw_payload_len_]);
+        memcpy(payload_buffer_.get(), &bitstream[header_.size()], raw_payload_len_);
+        raw_payload_ = payload_buffer_.get();
+      }
 
-      // Rest of the function goes inside the V3C unit payload and parses it into NAL units
-      // Now start to parse the NAL sample stream
-      for (size_t ptr = sample_stream_hdr_offset + header_.size(); ptr < len;) {
+      // Lazy units are split on first access
+      if (!is_set(flags, PARSE_FLAGS::LAZY))
+      {
+        split_payload();
+      }
+    }
+  }
 
-        size_t nal_size = V3C::parse_sample_stream_size(&bitstream[ptr], nal_size_precision);
-        ptr += nal_size_precision;
+  V3C_Unit::V3C_Unit(std::shared_ptr<const char[]> bitstream, const size_t len, const PARSE_FLAGS flags) :
+    V3C_Unit(bitstream.get(), len, flags | PARSE_FLAGS::BORROW)
+  {
+    // Vps payload is copied so it does not need the buffer
+    if (type() != V3C_VPS) borrowed_buffer_ = std::move(bitstream);
+  }
 
-        Nalu new_nalu(&bitstream[ptr], nal_size, type());
-        ptr += nal_size;
-        payload_.push_back(std::move(new_nalu));
-      }
+  void V3C_Unit::split_payload() const
+  {
+    if (!raw_payload_) return;
+
+    const uint8_t nal_size_precision = payload_.size_precision();
+
+    // Nalus reference the raw payload, which is either owned by this unit or borrowed from a buffer that outlives it
+    for (size_t ptr = payload_.header_size; ptr < raw_payload_len_;) {
+
+      size_t nal_size = V3C::parse_sample_stream_size(&raw_payload_[ptr], nal_size_precision);
+      ptr += nal_size_precision;
+
+      Nalu new_nalu(&raw_payload_[ptr], nal_size, type(), false);
+      ptr += nal_size;
+      payload_.push_back(std::move(new_nalu));
     }
+
+    raw_payload_ = nullptr;
+    raw_payload_len_ = 0;
   }
 
   /*+
@@ -115,6 +150,7 @@ namespace uvgV3CRTP {
   template <V3C_UNIT_TYPE E>
   size_t V3C_Unit::size() const
   {
+    if (raw_payload_) return header_.size() + raw_payload_len_;
     return header_.size() + payload_.size();
   }
 
@@ -153,73 +189,171 @@ namespace uvgV3CRTP {
     return payload_.size_precision();
   }
 
-  V3C_Unit::nalu_ref_list V3C_Unit::nalus() const
+  uint8_t V3C_Unit::target_nal_precision(const uint8_t nal_size_precision) const
+  {
+    if (type() == V3C_VPS || nal_size_precision == 0) return payload_.size_precision();
+    if (nal_size_precision > MAX_V3C_SIZE_PREC) throw std::invalid_argument("Nal size precision needs to be [1,8] or 0.");
+    return nal_size_precision;
+  }
+
+  // Call f(nalu, nalu_size) for each nalu of a serialized nal sample stream. Used to rewrite size fields without splitting the payload
+  template <typename F>
+  static size_t for_each_raw_nalu(const char * const payload, const size_t len, const size_t header_size, const uint8_t precision, F&& f)
+  {
+    size_t num_nalus = 0;
+    for (size_t ptr = header_size; ptr < len;)
+    {
+      const size_t nal_size = V3C::parse_sample_stream_size(&payload[ptr], precision);
+      ptr += precision;
+      if (ptr + nal_size > len) throw ParseException("Nalu exceeds V3C unit payload");
+      f(&payload[ptr], nal_size);
+      ptr += nal_size;
+      ++num_nalus;
+    }
+    return num_nalus;
+  }
+
+  static void check_nal_size(const size_t nal_size, const uint8_t precision)
+  {
+    if (precision < MAX_V3C_SIZE_PREC && (nal_size >> (precision * SIZE_PREC_MULT)) != 0)
+    {
+      throw std::length_error("Nalu of " + std::to_string(nal_size) + " bytes does not fit size precision " + std::to_string(precision));
+    }
+  }
+
+  size_t V3C_Unit::size(const uint8_t nal_size_precision) const
   {
-    // Populate nalu refs
-    nalu_ref_list nalu_refs = {};
-    for (const auto& nalu : payload_)
+    const uint8_t precision = target_nal_precision(nal_size_precision);
+    const uint8_t cur_precision = payload_.size_precision();
+    if (precision == cur_precision) return size();
+
+    if (raw_payload_)
     {
-      nalu_refs.push_back(std::ref(nalu));
+      // Only the size fields change size
+      const size_t num_nalus = for_each_raw_nalu(raw_payload_, raw_payload_len_, payload_.header_size, cur_precision, [](const char*, const size_t) {});
+      return header_.size() + raw_payload_len_ + num_nalus * precision - num_nalus * cur_precision;
     }
-    return nalu_refs;
+    return header_.size() + payload_.size(precision);
+  }
+
+  V3C_Unit::Nalu_Range V3C_Unit::nalus() const
+  {
+    split_payload();
+    return Nalu_Range(payload_);
   }
 
   size_t V3C_Unit::num_nalus() const
   {
+    split_payload();
     return payload_.num_samples();
   }
 
+  bool V3C_Unit::is_split() const
+  {
+    return raw_payload_ == nullptr;
+  }
+
   void V3C_Unit::push_back(Nalu && nalu)
   {
-    if (payload_.num_samples() == 0 && !is_timestamp_set() && nalu.is_timestamp_set())
+    split_payload();
+    if (!is_timestamp_set() && nalu.is_timestamp_set())
     {
-      // If timestamp is not set and this is the first nalu, set the v3c units timestamp to the nalus timestamp
+      // If timestamp is not set, set the v3c units timestamp to the nalus timestamp
       set_timestamp(nalu.get_timestamp());
     }
-    else if (is_timestamp_set() && !nalu.is_timestamp_set())
-    {
-      // If timestamp is set for the v3c unit but not for the nalu, set the nalu timestamp to match the v3c unit
-      nalu.set_timestamp(get_timestamp());
-    }
     // Check that the nalu timestamp matches v3c units timestamp, if not this nalu does not belong to this v3c unit
-    else if (is_timestamp_set() && nalu.get_timestamp() != get_timestamp())
+    else if (is_timestamp_set() && nalu.is_timestamp_set() && nalu.get_timestamp() != get_timestamp())
     {
       //TODO: might be better to handle with return value
       throw TimestampException("Nalu timestamp does not match V3C unit timestamp");
     }
+    nalu.unset_timestamp(); // The nalu inherits the unit timestamp from now on
     payload_.push_back(std::move(nalu));
   }
 
-  void V3C_Unit::set_timestamp(const uint32_t timestamp) const
+
+  size_t V3C_Unit::write_bitstream(char * const bitstream) const
   {
-    Timestamp::set_timestamp(timestamp);
-    // Also set the timestamp for all NALUs in the payload
-    for (const auto& nalu : payload_)
+    size_t ptr = 0;
+    ptr += header_.write_header(&bitstream[ptr]);
+    if (raw_payload_)
     {
-      nalu.set_timestamp(timestamp);
+      // Unsplit payload is already in the serialized format
+      memcpy(&bitstream[ptr], raw_payload_, raw_payload_len_);
+      ptr += raw_payload_len_;
     }
-  }
-
-  void V3C_Unit::unset_timestamp() const
-  {
-    Timestamp::unset_timestamp();
-    // Also unset the timestamp for all NALUs in the payload
-    for (const auto& nalu : payload_)
+    else
     {
-      nalu.unset_timestamp();
+      ptr += payload_.write_bitstream(&bitstream[ptr]);
     }
-  }
 
+    return ptr;
+  }
 
-  size_t V3C_Unit::write_bitstream(char * const bitstream) const
+  size_t V3C_Unit::write_bitstream(char * const bitstream, const uint8_t nal_size_precision) const
   {
+    const uint8_t precision = target_nal_precision(nal_size_precision);
+    const uint8_t cur_precision = payload_.size_precision();
+    if (precision == cur_precision) return write_bitstream(bitstream);
+
     size_t ptr = 0;
     ptr += header_.write_header(&bitstream[ptr]);
-    ptr += payload_.write_bitstream(&bitstream[ptr]);
+    if (raw_payload_)
+    {
+      // Copy nalus from the unsplit payload with new size fields
+      if (payload_.header_size > 0) ptr += V3C::write_size_precision(&bitstream[ptr], precision);
+      for_each_raw_nalu(raw_payload_, raw_payload_len_, payload_.header_size, cur_precision, [&](const char * const nalu, const size_t nal_size)
+        {
+          check_nal_size(nal_size, precision);
+          ptr += V3C::write_sample_stream_size(&bitstream[ptr], nal_size, precision);
+          memcpy(&bitstream[ptr], nalu, nal_size);
+          ptr += nal_size;
+        });
+    }
+    else
+    {
+      ptr += payload_.write_bitstream(&bitstream[ptr], precision);
+    }
 
     return ptr;
   }
 
+  void V3C_Unit::write_segments(Segment_Writer& writer, const uint8_t nal_size_precision) const
+  {
+    const uint8_t precision = target_nal_precision(nal_size_precision);
+    const uint8_t cur_precision = payload_.size_precision();
+    if (precision == cur_precision) return write_segments(writer);
+
+    header_.write_header(writer.scratch(header_.size()));
+    if (raw_payload_)
+    {
+      if (payload_.header_size > 0) V3C::write_size_precision(writer.scratch(payload_.header_size), precision);
+      for_each_raw_nalu(raw_payload_, raw_payload_len_, payload_.header_size, cur_precision, [&](const char * const nalu, const size_t nal_size)
+        {
+          check_nal_size(nal_size, precision);
+          V3C::write_sample_stream_size(writer.scratch(precision), nal_size, precision);
+          writer.reference(nalu, nal_size);
+        });
+    }
+    else
+    {
+      payload_.write_segments(writer, precision);
+    }
+  }
+
+  void V3C_Unit::write_segments(Segment_Writer& writer) const
+  {
+    header_.write_header(writer.scratch(header_.size()));
+    if (raw_payload_)
+    {
+      writer.reference(raw_payload_, raw_payload_len_);
+    }
+    else
+    {
+      payload_.write_segments(writer);
+    }
+  }
+
 
   V3C_Unit::V3C_Unit_Header::V3C_Unit_Header() : V3C_Unit_Header(V3C_VPS)
   {
@@ -229,137 +363,149 @@ namespace uvgV3CRTP {
   {
   }
 
+  namespace {
+    // Call f with the unit type as a compile time constant so the per type codec is selected once
+    template <typename F>
+    decltype(auto) dispatch_type(const V3C_UNIT_TYPE type, F&& f)
+    {
+      switch (type)
+      {
+      case V3C_VPS:
+        return f(std::integral_constant<V3C_UNIT_TYPE, V3C_VPS>{});
+      case V3C_AD:
+        return f(std::integral_constant<V3C_UNIT_TYPE, V3C_AD>{});
+      case V3C_OVD:
+        return f(std::integral_constant<V3C_UNIT_TYPE, V3C_OVD>{});
+      case V3C_GVD:
+        return f(std::integral_constant<V3C_UNIT_TYPE, V3C_GVD>{});
+      case V3C_AVD:
+        return f(std::integral_constant<V3C_UNIT_TYPE, V3C_AVD>{});
+      case V3C_PVD:
+        return f(std::integral_constant<V3C_UNIT_TYPE, V3C_PVD>{});
+      case V3C_CAD:
+        return f(std::integral_constant<V3C_UNIT_TYPE, V3C_CAD>{});
+      default:
+        throw std::invalid_argument("Not a valid unit type");
+      }
+    }
+
+    // vuh_unit_type is 5 bits, reserved values map to V3C_UNDEF
+    constexpr std::array<V3C_UNIT_TYPE, 32> VUH_TO_TYPE = []() {
+      std::array<V3C_UNIT_TYPE, 32> lut = {};
+      for (auto& type : lut) type = V3C_UNDEF;
+      lut[0] = V3C_VPS;
+      lut[1] = V3C_AD;
+      lut[2] = V3C_OVD;
+      lut[3] = V3C_GVD;
+      lut[4] = V3C_AVD;
+      lut[5] = V3C_PVD;
+      lut[6] = V3C_CAD;
+      return lut;
+    }();
+
+    inline uint32_t read_vuh(const char * const bitstream)
+    {
+      const auto* bytes = reinterpret_cast<const uint8_t*>(bitstream);
+      return (static_cast<uint32_t>(bytes[0]) << 24) | (static_cast<uint32_t>(bytes[1]) << 16) |
+             (static_cast<uint32_t>(bytes[2]) << 8)  |  static_cast<uint32_t>(bytes[3]);
+    }
+  }
+
   V3C_Unit::V3C_Unit_Header::V3C_Unit_Header(const char * const bitstream):
     vuh_unit_type((bitstream[0] & 0b11111000) >> 3),
     type(vuh_to_type(vuh_unit_type))
   {
-    vuh_v3c_parameter_set_id = 0;
-    vuh_atlas_id = 0;
+    dispatch_type(type, [&](auto type_c) { decode_fields<decltype(type_c)::value>(bitstream); });
+  }
 
-    if (type == V3C_AVD || type == V3C_GVD ||
-        type == V3C_OVD || type == V3C_AD ||
-        type == V3C_CAD || type == V3C_PVD) {
+  // V3C unit header as a big-endian 32-bit word:
+  //  vuh_unit_type                  [31:27]
+  //  vuh_v3c_parameter_set_id       [26:23] (not VPS)
+  //  vuh_atlas_id                   [22:17] (not VPS, CAD)
+  //  GVD: vuh_map_index             [16:13]
+  //       vuh_auxiliary_video_flag  [12]
+  //  AVD: vuh_attribute_index       [16:10]
+  //       vuh_attribute_partition_index [9:5]
+  //       vuh_map_index             [4:1]
+  //       vuh_auxiliary_video_flag  [0]
+  template <V3C_UNIT_TYPE E>
+  void V3C_Unit::V3C_Unit_Header::decode_fields(const char * const bitstream)
+  {
+    const uint32_t vuh = read_vuh(bitstream);
 
-      // 3 last bits from first byte and 1 first bit from second byte
-      vuh_v3c_parameter_set_id = ((bitstream[0] & 0b111) << 1) | ((bitstream[1] & 0b10000000) >> 7);
+    if constexpr (E != V3C_VPS)
+    {
+      vuh_v3c_parameter_set_id = (vuh >> 23) & 0xF;
     }
-    if (type == V3C_AVD || type == V3C_GVD ||
-        type == V3C_OVD || type == V3C_AD ||
-        type == V3C_PVD) {
-
-      // 6 middle bits from the second byte
-      vuh_atlas_id = ((bitstream[1] & 0b01111110) >> 1);
+    if constexpr (E != V3C_VPS && E != V3C_CAD)
+    {
+      vuh_atlas_id = (vuh >> 17) & 0x3F;
     }
-
-    switch (type) {
-
-    case V3C_GVD:
-      // last bit of second byte and 3 first bytes of third byte
-      vuh_map_index = ((bitstream[1] & 0b1) << 3) | ((bitstream[2] & 0b11100000) >> 5);
-      // fourth bit of third byte
-      vuh_auxiliary_video_flag = (bitstream[2] & 0b00010000) >> 4;
-      break;
-
-    case V3C_AVD:
-      // last bit of second byte and 6 first bytes of third byte
-      vuh_attribute_index = ((bitstream[1] & 0b1) << 6) | ((bitstream[2] & 0b11111100) >> 2);
-      // 2 last bits of third byte and 3 first bits of fourth byte
-      vuh_attribute_partition_index = (bitstream[2] & 0b11) | ((bitstream[3] & 0b11100000) >> 5);
-      // fourth byte: 4 bits
-      vuh_map_index = (bitstream[3] & 0b00011110) >> 1;
-      // last bit of fourth byte
-      vuh_auxiliary_video_flag = (bitstream[3] & 0b1);
-      break;
-
-    default:
-      break;
+    if constexpr (E == V3C_GVD)
+    {
+      vuh_map_index = (vuh >> 13) & 0xF;
+      vuh_auxiliary_video_flag = (vuh >> 12) & 0x1;
+    }
+    if constexpr (E == V3C_AVD)
+    {
+      vuh_attribute_index = (vuh >> 10) & 0x7F;
+      vuh_attribute_partition_index = (vuh >> 5) & 0x1F;
+      vuh_map_index = (vuh >> 1) & 0xF;
+      vuh_auxiliary_video_flag = vuh & 0x1;
     }
-    return;
   }
 
-  size_t V3C_Unit::V3C_Unit_Header::write_header(char * const bitstream) const
+  template <V3C_UNIT_TYPE E>
+  size_t V3C_Unit::V3C_Unit_Header::encode_fields(char * const bitstream) const
   {
-    uint8_t hdr[V3C_HDR_LEN] = {};
+    uint32_t vuh = static_cast<uint32_t>(vuh_unit_type & 0x1F) << 27;
 
-    if (type != V3C_VPS)
+    if constexpr (E != V3C_VPS)
     {
-      // All V3C unit types have parameter_set_id in header
-      hdr[0] = (vuh_unit_type << 3) | ((vuh_v3c_parameter_set_id & 0b1110) >> 1);
-      hdr[1] = ((vuh_v3c_parameter_set_id & 0b1) << 7);
-
-      // Only CAD does NOT have atlas_id
-      if (type != V3C_CAD) {
-        hdr[1] = hdr[1] | ((vuh_atlas_id & 0b111111) << 1);
-      }
-      // GVD has map_index and aux_video_flag, then zeroes
-      if (type == V3C_GVD) {
-        hdr[1] = hdr[1] | ((vuh_map_index & 0b1000) >> 3);
-        hdr[2] = ((vuh_map_index & 0b111) << 5) | (static_cast<int>(vuh_auxiliary_video_flag) << 4);
-      }
-      else if (type == V3C_AVD) {
-        hdr[1] = hdr[1] | ((vuh_attribute_index & 0b1000000) >> 7);
-        hdr[2] = ((vuh_attribute_index & 0b111111) << 2) | ((vuh_attribute_partition_index & 0b11000) >> 3);
-        hdr[3] = ((vuh_attribute_partition_index & 0b111) << 5) | (vuh_map_index << 1) | static_cast<int>(vuh_auxiliary_video_flag);
-      }
+      vuh |= static_cast<uint32_t>(vuh_v3c_parameter_set_id & 0xF) << 23;
     }
-    else
+    if constexpr (E != V3C_VPS && E != V3C_CAD)
+    {
+      vuh |= static_cast<uint32_t>(vuh_atlas_id & 0x3F) << 17;
+    }
+    if constexpr (E == V3C_GVD)
+    {
+      vuh |= static_cast<uint32_t>(vuh_map_index & 0xF) << 13;
+      vuh |= static_cast<uint32_t>(vuh_auxiliary_video_flag) << 12;
+    }
+    if constexpr (E == V3C_AVD)
     {
-      //VPS only has vuh_unit_type field
-      hdr[0] = (vuh_unit_type << 3);
+      vuh |= static_cast<uint32_t>(vuh_attribute_index & 0x7F) << 10;
+      vuh |= static_cast<uint32_t>(vuh_attribute_partition_index & 0x1F) << 5;
+      vuh |= static_cast<uint32_t>(vuh_map_index & 0xF) << 1;
+      vuh |= static_cast<uint32_t>(vuh_auxiliary_video_flag);
     }
 
-    // Copy V3C header to outbut buffer
-    memcpy(bitstream, hdr, size());
+    bitstream[0] = static_cast<char>(vuh >> 24);
+    bitstream[1] = static_cast<char>(vuh >> 16);
+    bitstream[2] = static_cast<char>(vuh >> 8);
+    bitstream[3] = static_cast<char>(vuh);
 
-    return size();
+    return V3C_HDR_LEN;
+  }
+
+  size_t V3C_Unit::V3C_Unit_Header::write_header(char * const bitstream) const
+  {
+    return dispatch_type(type, [&](auto type_c) { return encode_fields<decltype(type_c)::value>(bitstream); });
   }
 
   V3C_UNIT_TYPE V3C_Unit::V3C_Unit_Header::vuh_to_type(const uint8_t vuh_unit_type)
   {
-    switch (vuh_unit_type)
-    {
-    case 0:
-      return V3C_VPS;
-    case 1:
-      return V3C_AD;
-    case 2:
-      return V3C_OVD;
-    case 3:
-      return V3C_GVD;
-    case 4:
-      return V3C_AVD;
-    case 5:
-      return V3C_PVD;
-    case 6:
-      return V3C_CAD;
-    default:
-      throw std::invalid_argument("Not a recognized unit type");
-      //return V3C_UNDEF;
-    }
+    const V3C_UNIT_TYPE type = vuh_unit_type < VUH_TO_TYPE.size() ? VUH_TO_TYPE[vuh_unit_type] : V3C_UNDEF;
+    if (type == V3C_UNDEF) throw std::invalid_argument("Not a recognized unit type");
+    return type;
   }
 
   uint8_t V3C_Unit::V3C_Unit_Header::type_to_vuh(const V3C_UNIT_TYPE type)
   {
-    switch (type)
-    {
-    case V3C_VPS:
-      return 0;
-    case V3C_AD:
-      return 1;
-    case V3C_OVD:
-      return 2;
-    case V3C_GVD:
-      return 3;
-    case V3C_AVD:
-      return 4;
-    case V3C_PVD:
-      return 5;
-    case V3C_CAD:
-      return 6;
-    default:
-      throw std::invalid_argument("Not a valid unit type");
-      //return static_cast<uint8_t>(-1);
-    }
+    // Unit types are defined to match vuh_unit_type values
+    if (type < V3C_VPS || type >= NUM_V3C_UNIT_TYPES) throw std::invalid_argument("Not a valid unit type");
+    return static_cast<uint8_t>(type);
   }
 
   // Define specialization for template function so code is generated when built as a library
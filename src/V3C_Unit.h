@@ -10,6 +10,7 @@
 #include <tuple>
 #include <utility>
 #include <type_traits>
+#include <memory>
 
 namespace uvgV3CRTP {
 
@@ -88,6 +89,12 @@ namespace uvgV3CRTP {
       size_t size() const { return V3C_HDR_LEN; };
       static V3C_UNIT_TYPE vuh_to_type(const uint8_t vuh_unit_type);
       static uint8_t type_to_vuh(const V3C_UNIT_TYPE type);
+
+      // Field codec specialized for each unit type
+      template <V3C_UNIT_TYPE E>
+      void decode_fields(const char * const bitstream);
+      template <V3C_UNIT_TYPE E>
+      size_t encode_fields(char * const bitstream) const;
     };
 
     V3C_Unit(V3C_UNIT_TYPE type = V3C_VPS):
@@ -107,7 +114,8 @@ namespace uvgV3CRTP {
       payload_(size_precision, get_sample_stream_header_size())
     {
     }
-    V3C_Unit(const char * const bitstream, const size_t len);
+    V3C_Unit(const char * const bitstream, const size_t len, const PARSE_FLAGS flags = PARSE_FLAGS::NUL); // With PARSE_FLAGS::BORROW nalus reference bitstream which needs to outlive the unit
+    V3C_Unit(std::shared_ptr<const char[]> bitstream, const size_t len, const PARSE_FLAGS flags = PARSE_FLAGS::NUL); // Always borrows, the unit keeps bitstream alive
 
     V3C_Unit(const V3C_Unit&) = delete;
     V3C_Unit& operator=(const V3C_Unit&) = delete;
@@ -126,30 +134,55 @@ namespace uvgV3CRTP {
     size_t size() const;
     template <V3C_UNIT_TYPE E>
     size_t size() const;
+    size_t size(const uint8_t nal_size_precision) const; // Size when written with the given nal size precision, 0 keeps the current precision
     
     uint8_t nal_size_precision() const;
 
-    using nalu_ref_list = std::vector<std::reference_wrapper<const Nalu>>;
-    nalu_ref_list nalus() const;
-    size_t num_nalus() const;
+    // Non-allocating view over the nalus of a unit. Valid as long as the unit is alive and no nalus are added
+    class Nalu_Range {
+    public:
+      using iterator = Sample_Stream<SAMPLE_STREAM_TYPE::NAL>::Iterator;
+
+      explicit Nalu_Range(const Sample_Stream<SAMPLE_STREAM_TYPE::NAL>& payload) : payload_(payload) {}
 
-    void push_back(Nalu&& nalu);
+      iterator begin() const { return payload_.begin(); }
+      iterator end() const { return payload_.end(); }
+      size_t size() const { return payload_.num_samples(); }
+      bool empty() const { return size() == 0; }
 
-    void set_timestamp(const uint32_t timestamp) const override; // Set the timestamp for the unit and all its NALUs. V3C unit timestamp should match Nalu timestamps
-    void unset_timestamp() const override; // Unset the timestamp for the unit and all its NALUs
+    private:
+      const Sample_Stream<SAMPLE_STREAM_TYPE::NAL>& payload_;
+    };
+    Nalu_Range nalus() const; // Splits a lazily parsed payload
+    size_t num_nalus() const; // Splits a lazily parsed payload
+    bool is_split() const; // False if payload has not been split into nalus yet
+
+    void push_back(Nalu&& nalu); // Nalu inherits the unit timestamp. Throws TimestampException if the nalu timestamp does not match
 
   protected:
 
     //friend std::unique_ptr<char[]> Sample_Stream<SAMPLE_STREAM_TYPE::V3C>::get_bitstream();
     friend Sample_Stream<SAMPLE_STREAM_TYPE::V3C>;
+    friend class Segment_Recorder; // Keeps a serialized copy of the latest VPS
     size_t write_bitstream(char* const bitstream) const;
+    size_t write_bitstream(char* const bitstream, const uint8_t nal_size_precision) const; // Rewrite nal size fields with the given precision while copying
+    void write_segments(Segment_Writer& writer) const; // Same output as write_bitstream, but payload is referenced instead of copied
+    void write_segments(Segment_Writer& writer, const uint8_t nal_size_precision) const;
 
   private:
     size_t get_sample_stream_header_size() const;
     uint8_t parse_precision(const char * const bitstream) const;
+    uint8_t target_nal_precision(const uint8_t nal_size_precision) const; // Resolve requested precision, vps payload has no size fields
+    void split_payload() const; // Parse raw payload into nalus. Not thread safe
 
     const V3C_Unit_Header header_;
-    Sample_Stream<SAMPLE_STREAM_TYPE::NAL> payload_;
+    mutable Sample_Stream<SAMPLE_STREAM_TYPE::NAL> payload_;
+
+    // Unsplit payload (incl. nal sample stream header). Points to payload_buffer_ unless borrowed
+    mutable const char* raw_payload_ = nullptr;
+    mutable size_t raw_payload_len_ = 0;
+    std::unique_ptr<char[]> payload_buffer_; // Backs the nalus of a parsed unit, freed with the unit
+    std::shared_ptr<const char[]> borrowed_buffer_; // Borrowed buffer owned by this unit alone, e.g. a unit reassembled from chunks
     
   };
 
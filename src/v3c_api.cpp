@@ -3,11 +3,17 @@
 #include "V3C_Receiver.h"
 #include "V3C_Sender.h"
 #include "Sample_Stream.h"
+#include "Sample_Stream_View.h"
+#include "Sample_Stream_Parser.h"
+#include "Sample_Stream_Writer.h"
+#include "Segment_Recorder.h"
+#include "Gof_Index.h"
 
 #include <type_traits>
 #include <utility>
 #include <array>
 #include <sstream>
+#include <fstream>
 #include <iterator>
 
 namespace uvgV3CRTP {
@@ -131,6 +137,12 @@ namespace uvgV3CRTP {
     connection_(nullptr),
     flags_(flags),
     data_(nullptr),
+    chunk_parser_(nullptr),
+    file_index_(nullptr),
+    recorder_(nullptr),
+    release_recorded_gofs_(false),
+    num_recorded_gofs_(0),
+    segment_recorder_(nullptr),
     cur_gof_it_(nullptr),
     is_gof_it_valid_(false),
     cur_gof_ind_(0),
@@ -144,6 +156,12 @@ namespace uvgV3CRTP {
     connection_(nullptr), 
     flags_(flags), 
     data_(nullptr), 
+    chunk_parser_(nullptr),
+    file_index_(nullptr),
+    recorder_(nullptr),
+    release_recorded_gofs_(false),
+    num_recorded_gofs_(0),
+    segment_recorder_(nullptr),
     cur_gof_it_(nullptr), 
     is_gof_it_valid_(false),
     cur_gof_ind_(0),
@@ -157,6 +175,12 @@ namespace uvgV3CRTP {
     connection_(nullptr),
     flags_(flags),
     data_(nullptr),
+    chunk_parser_(nullptr),
+    file_index_(nullptr),
+    recorder_(nullptr),
+    release_recorded_gofs_(false),
+    num_recorded_gofs_(0),
+    segment_recorder_(nullptr),
     cur_gof_it_(nullptr),
     is_gof_it_valid_(false),
     cur_gof_ind_(0),
@@ -172,6 +196,12 @@ namespace uvgV3CRTP {
     connection_(nullptr), 
     flags_(flags), 
     data_(nullptr), 
+    chunk_parser_(nullptr),
+    file_index_(nullptr),
+    recorder_(nullptr),
+    release_recorded_gofs_(false),
+    num_recorded_gofs_(0),
+    segment_recorder_(nullptr),
     cur_gof_it_(nullptr), 
     is_gof_it_valid_(false), 
     cur_gof_ind_(0),
@@ -186,6 +216,12 @@ namespace uvgV3CRTP {
     connection_(nullptr),
     flags_(flags),
     data_(nullptr),
+    chunk_parser_(nullptr),
+    file_index_(nullptr),
+    recorder_(nullptr),
+    release_recorded_gofs_(false),
+    num_recorded_gofs_(0),
+    segment_recorder_(nullptr),
     cur_gof_it_(nullptr),
     is_gof_it_valid_(false),
     cur_gof_ind_(0),
@@ -200,6 +236,12 @@ namespace uvgV3CRTP {
     connection_(nullptr), 
     flags_(flags), 
     data_(nullptr), 
+    chunk_parser_(nullptr),
+    file_index_(nullptr),
+    recorder_(nullptr),
+    release_recorded_gofs_(false),
+    num_recorded_gofs_(0),
+    segment_recorder_(nullptr),
     cur_gof_it_(nullptr), 
     is_gof_it_valid_(false), 
     cur_gof_ind_(0),
@@ -214,7 +256,10 @@ namespace uvgV3CRTP {
   {
     if (connection_) delete connection_;
     connection_ = nullptr;
+    if (recorder_ || segment_recorder_) stop_recording();
     clear_sample_stream();
+    if (file_index_) delete file_index_;
+    file_index_ = nullptr;
   }
 
   template<typename T>
@@ -226,12 +271,12 @@ namespace uvgV3CRTP {
   }
 
   template<typename T>
-  ERROR_TYPE V3C_State<T>::init_sample_stream(const char * bitstream, size_t len) noexcept
+  ERROR_TYPE V3C_State<T>::init_sample_stream(const char * bitstream, size_t len, PARSE_FLAGS parse_flags, size_t num_threads, INIT_FLAGS unit_filter) noexcept
   {
     if (!validate_nodata()) return get_error_flag();
     V3C_STATE_TRY(this)
     {
-      data_ = new Sample_Stream<SAMPLE_STREAM_TYPE::V3C>(V3C::parse_bitstream(bitstream, len));
+      data_ = new Sample_Stream<SAMPLE_STREAM_TYPE::V3C>(V3C::parse_bitstream(bitstream, len, parse_flags, num_threads, unit_filter));
       // If this is a sender state, init timestamps for the new data
       if constexpr (std::is_same<T, V3C_Sender>::value)
       {
@@ -244,7 +289,106 @@ namespace uvgV3CRTP {
   }
 
   template<typename T>
-  ERROR_TYPE V3C_State<T>::append_to_sample_stream(const char* bitstream, size_t len, bool has_sample_stream_headers) noexcept
+  ERROR_TYPE V3C_State<T>::init_sample_stream(std::shared_ptr<const char[]> bitstream, size_t len, size_t num_threads, INIT_FLAGS unit_filter) noexcept
+  {
+    if (!validate_nodata()) return get_error_flag();
+    V3C_STATE_TRY(this)
+    {
+      data_ = new Sample_Stream<SAMPLE_STREAM_TYPE::V3C>(V3C::parse_bitstream(std::move(bitstream), len, num_threads, unit_filter));
+      // If this is a sender state, init timestamps for the new data
+      if constexpr (std::is_same<T, V3C_Sender>::value)
+      {
+        this->set_timestamps(static_cast<V3C_Sender*>(connection_)->get_initial_timestamp());
+      }
+    }
+    V3C_STATE_CATCH(false);
+
+    return init_cur_gof();
+  }
+
+  template<typename T>
+  ERROR_TYPE V3C_State<T>::init_sample_stream_from_file(const char* path, size_t num_threads, INIT_FLAGS unit_filter) noexcept
+  {
+    if (!validate_nodata()) return get_error_flag();
+    V3C_STATE_TRY(this)
+    {
+      data_ = new Sample_Stream<SAMPLE_STREAM_TYPE::V3C>(V3C::parse_file(path, num_threads, unit_filter));
+      // If this is a sender state, init timestamps for the new data
+      if constexpr (std::is_same<T, V3C_Sender>::value)
+      {
+        this->set_timestamps(static_cast<V3C_Sender*>(connection_)->get_initial_timestamp());
+      }
+    }
+    V3C_STATE_CATCH(false);
+
+    return init_cur_gof();
+  }
+
+  template<typename T>
+  ERROR_TYPE V3C_State<T>::init_sample_stream_from_file(const char* path, size_t first_gof, size_t last_gof, const char* index_path, INIT_FLAGS unit_filter) noexcept
+  {
+    if (!validate_nodata()) return get_error_flag();
+    V3C_STATE_TRY(this)
+    {
+      size_t len = 0;
+      std::shared_ptr<const char[]> mapping = V3C::map_file(path, len);
+
+      // Reuse the index if it was already built for this file
+      if (!file_index_ || file_index_path_ != path || file_index_->bitstream_len() != len)
+      {
+        Gof_Index index;
+        bool is_loaded = false;
+        if (index_path)
+        {
+          std::ifstream index_in(index_path);
+          if (index_in.is_open())
+          {
+            try
+            {
+              index = Gof_Index::load(index_in);
+              is_loaded = index.bitstream_len() == len; // Sidecar of a different version of the file is stale
+            }
+            catch (const ParseException&)
+            {
+              // Corrupt, truncated or outdated sidecar, rebuild it below
+            }
+          }
+        }
+        const bool write_index = index_path && !is_loaded;
+        if (!is_loaded)
+        {
+          index = Gof_Index::build(mapping.get(), len);
+        }
+
+        if (file_index_) delete file_index_;
+        file_index_ = new Gof_Index(std::move(index));
+        file_index_path_ = path;
+
+        if (write_index)
+        {
+          std::ofstream index_out(index_path, std::ios::trunc);
+          file_index_->save(index_out);
+          index_out.close();
+          if (!index_out) throw std::runtime_error(std::string("Failed to write gof index to ") + index_path);
+        }
+      }
+
+      data_ = new Sample_Stream<SAMPLE_STREAM_TYPE::V3C>(file_index_->materialize(mapping.get(), len, first_gof, last_gof, PARSE_FLAGS::BORROW, unit_filter));
+      data_->add_backing_buffer(std::move(mapping));
+      // If this is a sender state, init timestamps for the new data
+      if constexpr (std::is_same<T, V3C_Sender>::value)
+      {
+        this->set_timestamps(static_cast<V3C_Sender*>(connection_)->get_initial_timestamp());
+      }
+    }
+    V3C_STATE_CATCH(false);
+    if (!data_) return get_error_flag(); // Keep the original error instead of a missing data error
+
+    return init_cur_gof();
+  }
+
+  template<typename T>
+  ERROR_TYPE V3C_State<T>::append_to_sample_stream(const char* bitstream, size_t len, bool has_sample_stream_headers, PARSE_FLAGS parse_flags, INIT_FLAGS unit_filter) noexcept
   {
     if (!validate_data()) return get_error_flag();
     // Adding to sample stream will invalidate the current gof iterator
@@ -256,13 +400,13 @@ namespace uvgV3CRTP {
       if (has_sample_stream_headers)
       {
         data_->push_back(
-          V3C::parse_bitstream(bitstream, len)
+          V3C::parse_bitstream(bitstream, len, parse_flags, 1, unit_filter)
         );
       }
-      else
+      else if (!V3C::is_filtered_unit(bitstream, len, unit_filter))
       {
         data_->push_back(
-          V3C_Unit(bitstream, len)
+          V3C_Unit(bitstream, len, parse_flags)
         );
       }
       // If this is a sender state, init timestamps for the new data
@@ -278,6 +422,57 @@ namespace uvgV3CRTP {
     return gof_at(cur_gof_ind_);
   }
 
+  template<typename T>
+  ERROR_TYPE V3C_State<T>::append_chunk_to_sample_stream(const char* chunk, size_t len, INIT_FLAGS unit_filter) noexcept
+  {
+    if (len == 0) return ERROR_TYPE::OK;
+    size_t num_units = 0;
+    bool parsed = false;
+    V3C_STATE_TRY(this)
+    {
+      if (!chunk_parser_)
+      {
+        chunk_parser_ = new Sample_Stream_Parser();
+      }
+      // Initialize sample stream based on the sample stream header of the first chunk
+      if (!data_)
+      {
+        if (chunk_parser_->size_precision() == 0)
+        {
+          data_ = new Sample_Stream<SAMPLE_STREAM_TYPE::V3C>(V3C::parse_size_precision(chunk));
+        }
+        else
+        {
+          data_ = new Sample_Stream<SAMPLE_STREAM_TYPE::V3C>(chunk_parser_->size_precision());
+        }
+      }
+      // If this is a sender state, init timestamps for new data if sample stream is empty
+      [[maybe_unused]] const bool is_empty = data_->num_samples() == 0;
+      num_units = chunk_parser_->parse_chunk(chunk, len, *data_, unit_filter);
+      if constexpr (std::is_same<T, V3C_Sender>::value)
+      {
+        if (is_empty && num_units > 0) {
+          this->set_timestamps(static_cast<V3C_Sender*>(connection_)->get_initial_timestamp());
+        }
+      }
+      parsed = true;
+    }
+    V3C_STATE_CATCH(false);
+    if (!parsed)
+    {
+      // Units before the error may have been added
+      is_gof_it_valid_ = false;
+      return get_error_flag();
+    }
+
+    // Only buffered a partial unit, current gof iterator is still valid
+    if (num_units == 0) return ERROR_TYPE::OK;
+
+    // Adding to sample stream will invalidate the current gof iterator
+    is_gof_it_valid_ = false;
+    return gof_at(cur_gof_ind_);
+  }
+
   template<typename T>
   void V3C_State<T>::clear_sample_stream() noexcept
   {
@@ -287,16 +482,32 @@ namespace uvgV3CRTP {
       {
         // Set initial timestamp to last timestamp + frame duration so that if new data is added, timestamps are continuous
         static_cast<V3C_Sender*>(connection_)->set_initial_timestamp(
-          V3C::calc_new_timestamp(data_->back().get_timestamp(), DEFAULT_FRAME_RATE, RTP_CLOCK_RATE)
+          V3C::calc_new_timestamp(data_->timestamp(data_->back()), DEFAULT_FRAME_RATE, RTP_CLOCK_RATE)
         );
       }
     }
-    if (data_)       delete data_;
-    if (cur_gof_it_) delete get_it_ptr(cur_gof_it_);
+    if (data_)         delete data_;
+    if (chunk_parser_) delete chunk_parser_;
+    if (cur_gof_it_)   delete get_it_ptr(cur_gof_it_);
     data_ = nullptr;
+    chunk_parser_ = nullptr;
     cur_gof_it_ = nullptr;
     is_gof_it_valid_ = false;
     cur_gof_ind_ = 0;
+    num_recorded_gofs_ = 0;
+  }
+
+  template<typename T>
+  ERROR_TYPE V3C_State<T>::rebase_timestamps(uint32_t first_timestamp) noexcept
+  {
+    if (!validate_data()) return get_error_flag();
+
+    V3C_STATE_TRY(this)
+    {
+      data_->rebase_timestamps(first_timestamp);
+      return ERROR_TYPE::OK;
+    }
+    V3C_STATE_CATCH(true);
   }
 
   template<typename T>
@@ -348,29 +559,67 @@ namespace uvgV3CRTP {
   {
     if (!validate_data()) return;
 
+    // Gofs that already have timestamps are rebased by moving the stream offset instead of rewriting every gof, unit and nalu
+    if (data_->front().is_timestamp_set())
+    {
+      data_->rebase_timestamps(init_timestamp);
+      return;
+    }
+
     uint32_t timestamp = init_timestamp;
-    for (const auto& gof : *data_)
+    for (auto it = data_->begin(); it != data_->end(); ++it)
     {
-      gof.set_timestamp(timestamp);
+      data_->set_timestamp(it, timestamp);
       timestamp = V3C::calc_new_timestamp(timestamp, DEFAULT_FRAME_RATE, RTP_CLOCK_RATE);
     }
   }
 
   template<typename T>
-  char* V3C_State<T>::get_bitstream(size_t* length) const noexcept
+  char* V3C_State<T>::get_bitstream(size_t* length, size_t num_threads) const noexcept
   {
     if (!validate_data()) return nullptr;
 
     V3C_STATE_TRY(this)
     {
       if (length) *length = data_->size();
-      return data_->get_bitstream().release();
+      return data_->get_bitstream(num_threads).release();
     }
     V3C_STATE_CATCH(false);
     
     return nullptr;
   }
 
+  template<typename T>
+  char* V3C_State<T>::get_bitstream(size_t* length, uint8_t size_precision, const uint8_t nal_size_precisions[NUM_V3C_UNIT_TYPES]) const noexcept
+  {
+    if (!validate_data()) return nullptr;
+
+    V3C_STATE_TRY(this)
+    {
+      if (length) *length = data_->size(size_precision, nal_size_precisions);
+      return data_->get_bitstream(size_precision, nal_size_precisions).release();
+    }
+    V3C_STATE_CATCH(false);
+
+    return nullptr;
+  }
+
+  template<typename T>
+  char* V3C_State<T>::get_bitstream(INIT_FLAGS unit_filter, size_t* length) const noexcept
+  {
+    if (!validate_data()) return nullptr;
+
+    V3C_STATE_TRY(this)
+    {
+      const Sample_Stream_View view(*data_, unit_filter);
+      if (length) *length = view.size();
+      return view.get_bitstream().release();
+    }
+    V3C_STATE_CATCH(false);
+
+    return nullptr;
+  }
+
   template<typename T>
   char* V3C_State<T>::get_bitstream_cur_gof(size_t* length) const noexcept
   {
@@ -403,6 +652,214 @@ namespace uvgV3CRTP {
     return nullptr;
   }
 
+  template<typename T>
+  ERROR_TYPE V3C_State<T>::write_bitstream_into(char* dst, size_t cap, size_t* written, size_t num_threads) const noexcept
+  {
+    if (written) *written = 0;
+    if (!validate_data()) return get_error_flag();
+
+    V3C_STATE_TRY(this)
+    {
+      if (!dst || cap < data_->size()) return set_error(ERROR_TYPE::DATA, "Destination buffer too small for bitstream");
+      const size_t len = data_->write_bitstream_into(dst, cap, num_threads);
+      if (written) *written = len;
+      return ERROR_TYPE::OK;
+    }
+    V3C_STATE_CATCH(true);
+  }
+
+  template<typename T>
+  ERROR_TYPE V3C_State<T>::write_bitstream_into(INIT_FLAGS unit_filter, char* dst, size_t cap, size_t* written) const noexcept
+  {
+    if (written) *written = 0;
+    if (!validate_data()) return get_error_flag();
+
+    V3C_STATE_TRY(this)
+    {
+      const Sample_Stream_View view(*data_, unit_filter);
+      if (!dst || cap < view.size()) return set_error(ERROR_TYPE::DATA, "Destination buffer too small for bitstream");
+      const size_t len = view.write_bitstream_into(dst, cap);
+      if (written) *written = len;
+      return ERROR_TYPE::OK;
+    }
+    V3C_STATE_CATCH(true);
+  }
+
+  template<typename T>
+  ERROR_TYPE V3C_State<T>::write_bitstream_into_cur_gof(char* dst, size_t cap, size_t* written) const noexcept
+  {
+    if (written) *written = 0;
+    if (!validate_data()) return get_error_flag();
+    if (!validate_cur_gof()) return get_error_flag();
+
+    V3C_STATE_TRY(this)
+    {
+      if (!dst || cap < data_->size(get_it(cur_gof_it_))) return set_error(ERROR_TYPE::DATA, "Destination buffer too small for bitstream");
+      const size_t len = data_->write_bitstream_into(dst, cap, get_it(cur_gof_it_));
+      if (written) *written = len;
+      return ERROR_TYPE::OK;
+    }
+    V3C_STATE_CATCH(true);
+  }
+
+  template<typename T>
+  ERROR_TYPE V3C_State<T>::write_bitstream_into_cur_gof_unit(const V3C_UNIT_TYPE type, char* dst, size_t cap, size_t* written) const noexcept
+  {
+    if (written) *written = 0;
+    if (!validate_data()) return get_error_flag();
+    if (!validate_cur_gof()) return get_error_flag();
+
+    V3C_STATE_TRY(this)
+    {
+      if (!dst || cap < data_->size(get_it(cur_gof_it_), type)) return set_error(ERROR_TYPE::DATA, "Destination buffer too small for bitstream");
+      const size_t len = data_->write_bitstream_into(dst, cap, get_it(cur_gof_it_), type);
+      if (written) *written = len;
+      return ERROR_TYPE::OK;
+    }
+    V3C_STATE_CATCH(true);
+  }
+
+  template<typename T>
+  size_t V3C_State<T>::get_bitstream_size() const noexcept
+  {
+    if (!validate_data()) return 0;
+
+    V3C_STATE_TRY(this)
+    {
+      return data_->size();
+    }
+    V3C_STATE_CATCH(false);
+
+    return 0;
+  }
+
+  template<typename T>
+  size_t V3C_State<T>::get_bitstream_size(INIT_FLAGS unit_filter) const noexcept
+  {
+    if (!validate_data()) return 0;
+
+    V3C_STATE_TRY(this)
+    {
+      return Sample_Stream_View(*data_, unit_filter).size();
+    }
+    V3C_STATE_CATCH(false);
+
+    return 0;
+  }
+
+  template<typename T>
+  size_t V3C_State<T>::get_bitstream_size_cur_gof() const noexcept
+  {
+    if (!validate_data()) return 0;
+    if (!validate_cur_gof()) return 0;
+
+    V3C_STATE_TRY(this)
+    {
+      return data_->size(get_it(cur_gof_it_));
+    }
+    V3C_STATE_CATCH(false);
+
+    return 0;
+  }
+
+  template<typename T>
+  size_t V3C_State<T>::get_bitstream_size_cur_gof_unit(const V3C_UNIT_TYPE type) const noexcept
+  {
+    if (!validate_data()) return 0;
+    if (!validate_cur_gof()) return 0;
+
+    V3C_STATE_TRY(this)
+    {
+      return data_->size(get_it(cur_gof_it_), type);
+    }
+    V3C_STATE_CATCH(false);
+
+    return 0;
+  }
+
+  template<typename T>
+  BitstreamSegment* V3C_State<T>::get_bitstream_segments(size_t* num_segments, size_t* length) const noexcept
+  {
+    if (!validate_data()) return nullptr;
+
+    V3C_STATE_TRY(this)
+    {
+      if (!num_segments) throw std::invalid_argument("num_segments is null");
+      if (length) *length = data_->size();
+      return data_->get_bitstream_segments(*num_segments).release();
+    }
+    V3C_STATE_CATCH(false);
+
+    return nullptr;
+  }
+
+  template<typename T>
+  BitstreamSegment* V3C_State<T>::get_bitstream_segments(uint8_t size_precision, const uint8_t nal_size_precisions[NUM_V3C_UNIT_TYPES], size_t* num_segments, size_t* length) const noexcept
+  {
+    if (!validate_data()) return nullptr;
+
+    V3C_STATE_TRY(this)
+    {
+      if (!num_segments) throw std::invalid_argument("num_segments is null");
+      if (length) *length = data_->size(size_precision, nal_size_precisions);
+      return data_->get_bitstream_segments(size_precision, nal_size_precisions, *num_segments).release();
+    }
+    V3C_STATE_CATCH(false);
+
+    return nullptr;
+  }
+
+  template<typename T>
+  BitstreamSegment* V3C_State<T>::get_bitstream_segments(INIT_FLAGS unit_filter, size_t* num_segments, size_t* length) const noexcept
+  {
+    if (!validate_data()) return nullptr;
+
+    V3C_STATE_TRY(this)
+    {
+      if (!num_segments) throw std::invalid_argument("num_segments is null");
+      const Sample_Stream_View view(*data_, unit_filter);
+      if (length) *length = view.size();
+      return view.get_bitstream_segments(*num_segments).release();
+    }
+    V3C_STATE_CATCH(false);
+
+    return nullptr;
+  }
+
+  template<typename T>
+  BitstreamSegment* V3C_State<T>::get_bitstream_segments_cur_gof(size_t* num_segments, size_t* length) const noexcept
+  {
+    if (!validate_data()) return nullptr;
+    if (!validate_cur_gof()) return nullptr;
+
+    V3C_STATE_TRY(this)
+    {
+      if (!num_segments) throw std::invalid_argument("num_segments is null");
+      if (length) *length = data_->size(get_it(cur_gof_it_));
+      return data_->get_bitstream_segments(get_it(cur_gof_it_), *num_segments).release();
+    }
+    V3C_STATE_CATCH(false);
+
+    return nullptr;
+  }
+
+  template<typename T>
+  BitstreamSegment* V3C_State<T>::get_bitstream_segments_cur_gof_unit(const V3C_UNIT_TYPE type, size_t* num_segments, size_t* length) const noexcept
+  {
+    if (!validate_data()) return nullptr;
+    if (!validate_cur_gof()) return nullptr;
+
+    V3C_STATE_TRY(this)
+    {
+      if (!num_segments) throw std::invalid_argument("num_segments is null");
+      if (length) *length = data_->size(get_it(cur_gof_it_), type);
+      return data_->get_bitstream_segments(get_it(cur_gof_it_), type, *num_segments).release();
+    }
+    V3C_STATE_CATCH(false);
+
+    return nullptr;
+  }
+
   template<typename T>
   ERROR_TYPE V3C_State<T>::first_gof() noexcept
   {
@@ -445,6 +902,160 @@ namespace uvgV3CRTP {
     return data_->num_samples();
   }
 
+  template<typename T>
+  size_t V3C_State<T>::num_file_gofs() const noexcept
+  {
+    if (!file_index_)
+    {
+      set_error(ERROR_TYPE::DATA, "No file has been indexed");
+      return 0;
+    }
+    return file_index_->num_gofs();
+  }
+
+  template<typename T>
+  ERROR_TYPE V3C_State<T>::start_recording(int fd, uint8_t size_precision, bool release_recorded_gofs, const uint8_t nal_size_precisions[NUM_V3C_UNIT_TYPES]) noexcept
+  {
+    if (recorder_ || segment_recorder_) return set_error(ERROR_TYPE::DATA, "Recording already started");
+
+    V3C_STATE_TRY(this)
+    {
+      recorder_ = new Sample_Stream_Writer(fd, size_precision, nal_size_precisions);
+      release_recorded_gofs_ = release_recorded_gofs;
+      num_recorded_gofs_ = 0;
+      return ERROR_TYPE::OK;
+    }
+    V3C_STATE_CATCH(true);
+  }
+
+  template<typename T>
+  ERROR_TYPE V3C_State<T>::start_recording(std::ostream& out, uint8_t size_precision, bool release_recorded_gofs, const uint8_t nal_size_precisions[NUM_V3C_UNIT_TYPES]) noexcept
+  {
+    if (recorder_ || segment_recorder_) return set_error(ERROR_TYPE::DATA, "Recording already started");
+
+    V3C_STATE_TRY(this)
+    {
+      recorder_ = new Sample_Stream_Writer(out, size_precision, nal_size_precisions);
+      release_recorded_gofs_ = release_recorded_gofs;
+      num_recorded_gofs_ = 0;
+      return ERROR_TYPE::OK;
+    }
+    V3C_STATE_CATCH(true);
+  }
+
+  template<typename T>
+  ERROR_TYPE V3C_State<T>::start_segment_recording(const char* path_prefix, size_t gofs_per_segment, uint8_t size_precision, size_t max_queued_gofs) noexcept
+  {
+    if (recorder_ || segment_recorder_) return set_error(ERROR_TYPE::DATA, "Recording already started");
+    if (!path_prefix) return set_error(ERROR_TYPE::DATA, "No path prefix given for segments");
+
+    V3C_STATE_TRY(this)
+    {
+      segment_recorder_ = new Segment_Recorder(path_prefix, gofs_per_segment, size_precision, max_queued_gofs);
+      num_recorded_gofs_ = 0;
+      return ERROR_TYPE::OK;
+    }
+    V3C_STATE_CATCH(true);
+  }
+
+  template<typename T>
+  ERROR_TYPE V3C_State<T>::record_gofs(bool include_incomplete) noexcept
+  {
+    if (!recorder_ && !segment_recorder_) return set_error(ERROR_TYPE::DATA, "Recording not started");
+    if (!validate_data()) return get_error_flag();
+
+    V3C_STATE_TRY(this)
+    {
+      write_recorded_gofs(include_incomplete);
+      return ERROR_TYPE::OK;
+    }
+    V3C_STATE_CATCH(true);
+  }
+
+  template<typename T>
+  ERROR_TYPE V3C_State<T>::stop_recording() noexcept
+  {
+    if (!recorder_ && !segment_recorder_) return set_error(ERROR_TYPE::DATA, "Recording not started");
+
+    V3C_STATE_TRY(this)
+    {
+      if (data_) write_recorded_gofs(true);
+      if (recorder_) recorder_->finish();
+      if (segment_recorder_) segment_recorder_->finish();
+      delete recorder_;
+      recorder_ = nullptr;
+      delete segment_recorder_;
+      segment_recorder_ = nullptr;
+      num_recorded_gofs_ = 0;
+      return ERROR_TYPE::OK;
+    }
+    V3C_STATE_CATCH(false);
+
+    // Recording cannot be continued after an error
+    delete recorder_;
+    recorder_ = nullptr;
+    delete segment_recorder_;
+    segment_recorder_ = nullptr;
+    num_recorded_gofs_ = 0;
+
+    return get_error_flag();
+  }
+
+  template<typename T>
+  void V3C_State<T>::write_recorded_gofs(bool include_incomplete)
+  {
+    const size_t num_gofs = data_->num_samples();
+
+    // Segments are written on a background thread, so hand over complete gofs instead of serializing them here
+    if (segment_recorder_)
+    {
+      const size_t num_ready = (include_incomplete || num_gofs == 0) ? num_gofs : num_gofs - 1;
+      if (num_ready > 0)
+      {
+        segment_recorder_->push(data_->split_front(num_ready));
+        reposition_cur_gof(num_ready);
+      }
+      return;
+    }
+
+    auto it = std::next(data_->begin(), num_recorded_gofs_);
+    size_t num_written = 0;
+    for (size_t ind = num_recorded_gofs_; ind < num_gofs; ++ind, ++it)
+    {
+      // The last gof may still receive units or nalus
+      if (!include_incomplete && ind + 1 == num_gofs) break;
+      recorder_->write_gof(*data_, it);
+      ++num_written;
+    }
+    num_recorded_gofs_ += num_written;
+
+    if (release_recorded_gofs_ && num_recorded_gofs_ > 0)
+    {
+      const size_t num_released = data_->release_front(num_recorded_gofs_);
+      num_recorded_gofs_ = 0;
+      reposition_cur_gof(num_released);
+    }
+  }
+
+  template<typename T>
+  void V3C_State<T>::reposition_cur_gof(size_t num_released)
+  {
+    if (!cur_gof_it_) return;
+
+    const size_t cur_gof_ind = cur_gof_ind_;
+    is_gof_it_valid_ = false;
+    if (data_->num_samples() == 0)
+    {
+      delete get_it_ptr(cur_gof_it_);
+      cur_gof_it_ = nullptr;
+      cur_gof_ind_ = 0;
+    }
+    else
+    {
+      init_cur_gof(cur_gof_ind >= num_released ? cur_gof_ind - num_released : 0);
+    }
+  }
+
   template<typename T>
   ERROR_TYPE V3C_State<T>::next_gof() noexcept
   {
@@ -510,6 +1121,17 @@ namespace uvgV3CRTP {
     V3C_STATE_CATCH(true);
   }
 
+  ERROR_TYPE send_bitstream(V3C_State<V3C_Sender>* state, INIT_FLAGS unit_filter) noexcept
+  {
+    if (!state->validate_data()) return state->get_error_flag();
+
+    V3C_STATE_TRY(state)
+    {
+      state->connection_->send_bitstream(Sample_Stream_View(*state->data_, unit_filter), SEND_FRAME_RATE);
+    }
+    V3C_STATE_CATCH(true);
+  }
+
   ERROR_TYPE send_gof(V3C_State<V3C_Sender>* state) noexcept
   {
     if (!state->validate_data()) return state->get_error_flag();
@@ -517,7 +1139,7 @@ namespace uvgV3CRTP {
 
     V3C_STATE_TRY(state)
     {
-      state->connection_->send_gof(*get_it(state->cur_gof_it_));
+      state->connection_->send_gof(*get_it(state->cur_gof_it_), INIT_FLAGS::ALL, state->data_->timestamp_offset());
     }
     V3C_STATE_CATCH(true);
   }
@@ -529,7 +1151,8 @@ namespace uvgV3CRTP {
 
     V3C_STATE_TRY(state)
     {
-      state->connection_->send_v3c_unit((*get_it(state->cur_gof_it_)).get(type));
+      const V3C_Gof& gof = *get_it(state->cur_gof_it_);
+      state->connection_->send_v3c_unit(gof.get(type), gof, state->data_->timestamp_offset());
     }
     V3C_STATE_CATCH(true);
   }
@@ -616,16 +1239,18 @@ namespace uvgV3CRTP {
     return enum_map;
   }
 
-  static void check_timestamps(Iterator from, const Iterator to)
+  static void check_timestamps(const Sample_Stream<SAMPLE_STREAM_TYPE::V3C>& stream, Iterator from, const Iterator to)
   {
     if (from == to) return; // Nothing to check
 
+    // Compare absolute timestamps so the message shows the values seen on the wire
     for (Iterator next = std::next(from); next != to; ++from, ++next)
     {
-      const auto expected_timestamp = V3C::calc_new_timestamp((*from).get_timestamp(), DEFAULT_FRAME_RATE, RTP_CLOCK_RATE);
-      if ((*next).get_timestamp() != expected_timestamp)
+      const auto expected_timestamp = V3C::calc_new_timestamp(stream.timestamp(*from), DEFAULT_FRAME_RATE, RTP_CLOCK_RATE);
+      const auto timestamp = stream.timestamp(*next);
+      if (timestamp != expected_timestamp)
       {
-        throw TimestampException("Received GoF timestamp " + std::to_string((*next).get_timestamp()) + " does not match expected timestamp " + std::to_string(expected_timestamp));
+        throw TimestampException("Received GoF timestamp " + std::to_string(timestamp) + " does not match expected timestamp " + std::to_string(expected_timestamp));
       }
     }
   }
@@ -655,7 +1280,7 @@ namespace uvgV3CRTP {
       }
 
       // Also check that the timestamp is as expected
-      check_timestamps(state->data_->begin(), state->data_->end());
+      check_timestamps(*state->data_, state->data_->begin(), state->data_->end());
     }
     V3C_STATE_CATCH(true);
   }
@@ -701,6 +1326,7 @@ namespace uvgV3CRTP {
 
       // Try processing any leftover data in the receive buffer to avoid buildup
       state->connection_->push_buffer_to_sample_stream(*state->data_);
+      if (state->recorder_ || state->segment_recorder_) state->write_recorded_gofs(false);
       // throw warning if there is still leftover data in the receive buffer
       if (state->connection_->receive_buffer_size() > 0)
       {
@@ -708,7 +1334,7 @@ namespace uvgV3CRTP {
       }
 
       // Also check that the timestamp is as expected
-      if (state->data_->num_samples() > 1) check_timestamps(std::prev(state->data_->end(), 2), state->data_->end());
+      if (state->data_->num_samples() > 1) check_timestamps(*state->data_, std::prev(state->data_->end(), 2), state->data_->end());
     }
     V3C_STATE_CATCH(true);
   }
@@ -754,6 +1380,7 @@ namespace uvgV3CRTP {
       }
 
       // Try processing any leftover data in the receive buffer to avoid buildup
+      // Gofs are not recorded here: units of the next gof can arrive before the rest of a gof, so only the caller knows when a gof is complete
       state->connection_->push_buffer_to_sample_stream(*state->data_, unit_type);
       // throw warning if there is still leftover data in the receive buffer
       if (state->connection_->receive_buffer_size(unit_type) > 0)
@@ -762,7 +1389,7 @@ namespace uvgV3CRTP {
       }
 
       // Also check that the timestamp is as expected
-      if (state->data_->num_samples() > 1) check_timestamps(std::prev(state->data_->end(), 2), state->data_->end());
+      if (state->data_->num_samples() > 1) check_timestamps(*state->data_, std::prev(state->data_->end(), 2), state->data_->end());
     }
     V3C_STATE_CATCH(true);
   }
@@ -951,6 +1578,44 @@ namespace uvgV3CRTP {
     return nullptr;
   }
 
+  template<typename T>
+  char * V3C_State<T>::scan_bitstream_info_string(const char* bitstream, size_t len, const INFO_FMT fmt, size_t* out_len) const noexcept
+  {
+    V3C_STATE_TRY(this)
+    {
+      if (bitstream == nullptr || len == 0) throw ParseException("No bitstream to scan");
+      return write_info<V3C::InfoDataType>(V3C::scan_bitstream_info(bitstream, len), out_len, fmt);
+    }
+    V3C_STATE_CATCH(false);
+
+    return nullptr;
+  }
+
+  template<typename T>
+  ERROR_TYPE V3C_State<T>::scan_bitstream_info(const char* bitstream, size_t len, BitstreamInfo* out_info, HeaderStruct** out_gof_headers, size_t* out_num_gofs) const noexcept
+  {
+    V3C_STATE_TRY(this)
+    {
+      if (bitstream == nullptr || len == 0) throw ParseException("No bitstream to scan");
+
+      std::vector<std::array<HeaderStruct, NUM_V3C_UNIT_TYPES>> gof_headers;
+      const auto info = V3C::scan_bitstream_info(bitstream, len, out_gof_headers ? &gof_headers : nullptr, out_num_gofs);
+      if (out_info) V3C::populate_bitstream_info(info, *out_info);
+      if (out_gof_headers)
+      {
+        *out_gof_headers = nullptr;
+        if (!gof_headers.empty())
+        {
+          *out_gof_headers = static_cast<HeaderStruct*>(malloc(gof_headers.size() * sizeof(gof_headers[0])));
+          if (!*out_gof_headers) throw std::bad_alloc();
+          memcpy(*out_gof_headers, gof_headers.data(), gof_headers.size() * sizeof(gof_headers[0]));
+        }
+      }
+      return ERROR_TYPE::OK;
+    }
+    V3C_STATE_CATCH(true);
+  }
+
   template<typename T>
   char * V3C_State<T>::get_cur_gof_bitstream_info_string(const INFO_FMT fmt, size_t* out_len) const noexcept
   {
@@ -1072,7 +1737,7 @@ namespace uvgV3CRTP {
         }
 
         std::cout << "|--Gof #" << gof_ind << " (bitstream pos: " << (int)ptr << ", size (in sample stream): " << gof.size() << " (" << data_->size(std::next(data_->begin(), gof_ind)) << ")";
-        if (gof.is_timestamp_set()) std::cout << ", timestamp: " << gof.get_timestamp();
+        if (gof.is_timestamp_set()) std::cout << ", timestamp: " << data_->timestamp(gof);
         std::cout << ")";
         if (gof_ind == cur_gof_ind_) std::cout << " [cur gof]";
         std::cout << std::endl;
@@ -1119,7 +1784,7 @@ namespace uvgV3CRTP {
           {
             for (const auto& nal : unit.nalus())
             {
-              std::cout << "|  |  |--NAL unit of type " << (int)nal.get().nal_unit_type() << " (size: " << nal.get().size() << ")" << std::endl;
+              std::cout << "|  |  |--NAL unit of type " << (int)nal.nal_unit_type() << " (size: " << nal.size() << ")" << std::endl;
             }
           }
           ptr += data_->size(std::next(data_->begin(), gof_ind), type);